@@ -41,10 +41,15 @@
 #include <mares.h>
 #include <hw.h>
 #include <cressi.h>
+#include <export.h>
 #include <utils.h>
 
 static const char *g_cachedir = NULL;
 static int g_cachedir_read = 1;
+static const char *g_tracefile = NULL;
+static const char *g_previous = NULL;
+static const char *g_checkpoint = NULL;
+static export_format_t g_format = EXPORT_FORMAT_XML;
 
 typedef struct device_data_t {
 	device_type_t backend;
@@ -55,15 +60,11 @@ typedef struct device_data_t {
 typedef struct dive_data_t {
 	device_data_t *devdata;
 	FILE* fp;
+	dc_buffer_t *output;
 	unsigned int number;
 	dc_buffer_t *fingerprint;
 } dive_data_t;
 
-typedef struct sample_data_t {
-	FILE* fp;
-	unsigned int nsamples;
-} sample_data_t;
-
 typedef struct backend_table_t {
 	const char *name;
 	device_type_t type;
@@ -151,14 +152,9 @@ fpconvert (const char *fingerprint)
 }
 
 static dc_buffer_t *
-fpread (const char *dirname, device_type_t backend, unsigned int serial)
+fileread (const char *filename)
 {
-	// Build the filename.
-	char filename[1024] = {0};
-	snprintf (filename, sizeof (filename), "%s/%s-%08X.bin",
-		dirname, lookup_name (backend), serial);
-
-	// Open the fingerprint file.
+	// Open the file.
 	FILE *fp = fopen (filename, "rb");
 	if (fp == NULL)
 		return NULL;
@@ -179,6 +175,18 @@ fpread (const char *dirname, device_type_t backend, unsigned int serial)
 	return buffer;
 }
 
+static dc_buffer_t *
+fpread (const char *dirname, device_type_t backend, unsigned int serial)
+{
+	// Build the filename.
+	char filename[1024] = {0};
+	snprintf (filename, sizeof (filename), "%s/%s-%08X.bin",
+		dirname, lookup_name (backend), serial);
+
+	// Read the fingerprint file.
+	return fileread (filename);
+}
+
 static void
 fpwrite (dc_buffer_t *buffer, const char *dirname, device_type_t backend, unsigned int serial)
 {
@@ -203,6 +211,150 @@ fpwrite (dc_buffer_t *buffer, const char *dirname, device_type_t backend, unsign
 	fclose (fp);
 }
 
+static void
+bkfilename (char *filename, size_t size, const char *dirname, const char *devname)
+{
+	snprintf (filename, size, "%s/%s.backend",
+		dirname, devname ? devname : "null");
+
+	// Replace the path separators in the device name.
+	for (char *p = filename + strlen (dirname) + 1; *p; ++p) {
+		if (*p == '/' || *p == '\\' || *p == ':')
+			*p = '_';
+	}
+}
+
+static device_type_t
+bkread (const char *dirname, const char *devname)
+{
+	// Build the filename.
+	char filename[1024] = {0};
+	bkfilename (filename, sizeof (filename), dirname, devname);
+
+	// Open the backend file.
+	FILE *fp = fopen (filename, "r");
+	if (fp == NULL)
+		return DEVICE_TYPE_NULL;
+
+	// Read the backend name.
+	char name[32] = {0};
+	if (fgets (name, sizeof (name), fp) == NULL) {
+		fclose (fp);
+		return DEVICE_TYPE_NULL;
+	}
+
+	// Close the file.
+	fclose (fp);
+
+	// Strip the trailing newline.
+	name[strcspn (name, "\r\n")] = 0;
+
+	return lookup_type (name);
+}
+
+static void
+bkwrite (const char *dirname, const char *devname, device_type_t backend)
+{
+	// Build the filename.
+	char filename[1024] = {0};
+	bkfilename (filename, sizeof (filename), dirname, devname);
+
+	// Open the backend file.
+	FILE *fp = fopen (filename, "w");
+	if (fp == NULL)
+		return;
+
+	// Write the backend name.
+	fprintf (fp, "%s\n", lookup_name (backend));
+
+	// Close the file.
+	fclose (fp);
+}
+
+static void
+trwrite (device_t *device, const char *filename)
+{
+	// Retrieve the recorded traffic.
+	dc_buffer_t *buffer = dc_buffer_new (0);
+	if (device_dump_trace (device, buffer) != DEVICE_STATUS_SUCCESS) {
+		dc_buffer_free (buffer);
+		return;
+	}
+
+	// Open the trace file.
+	FILE *fp = fopen (filename, "w");
+	if (fp == NULL) {
+		dc_buffer_free (buffer);
+		return;
+	}
+
+	// Write one line per frame, with the timestamp (in
+	// seconds), the direction, the size and the data.
+	const unsigned char *data = dc_buffer_get_data (buffer);
+	unsigned int size = dc_buffer_get_size (buffer);
+	unsigned int offset = 0;
+	while (offset + 8 <= size) {
+		const unsigned char *frame = data + offset;
+		unsigned int timestamp = frame[0] + (frame[1] << 8) + (frame[2] << 16) + ((unsigned int) frame[3] << 24);
+		unsigned int length = frame[4] + (frame[5] << 8);
+		if (offset + 8 + length > size)
+			break;
+
+		fprintf (fp, "%u.%03u %s %u:", timestamp / 1000, timestamp % 1000,
+			frame[6] ? "W" : "R", length);
+		for (unsigned int i = 0; i < length; ++i)
+			fprintf (fp, " %02X", frame[8 + i]);
+		fprintf (fp, "\n");
+
+		offset += 8 + length;
+	}
+
+	// Close the file.
+	fclose (fp);
+
+	dc_buffer_free (buffer);
+}
+
+static void
+cpwrite (device_t *device, const char *filename)
+{
+	// Retrieve the checkpoint data.
+	dc_buffer_t *buffer = dc_buffer_new (0);
+	if (device_get_checkpoint (device, buffer) != DEVICE_STATUS_SUCCESS) {
+		dc_buffer_free (buffer);
+		return;
+	}
+
+	// Open the checkpoint file.
+	FILE *fp = fopen (filename, "wb");
+	if (fp == NULL) {
+		dc_buffer_free (buffer);
+		return;
+	}
+
+	// Write the checkpoint data.
+	fwrite (dc_buffer_get_data (buffer), 1, dc_buffer_get_size (buffer), fp);
+
+	// Close the file.
+	fclose (fp);
+
+	dc_buffer_free (buffer);
+}
+
+static device_status_t
+doclose (device_t *device)
+{
+	// Write the trace of the serial traffic.
+	if (g_tracefile)
+		trwrite (device, g_tracefile);
+
+	// Save the progress of an unfinished download.
+	if (g_checkpoint)
+		cpwrite (device, g_checkpoint);
+
+	return device_close (device);
+}
+
 volatile sig_atomic_t g_cancel = 0;
 
 void
@@ -222,60 +374,8 @@ cancel_cb (void *userdata)
 	return g_cancel;
 }
 
-void
-sample_cb (parser_sample_type_t type, parser_sample_value_t value, void *userdata)
-{
-	static const char *events[] = {
-		"none", "deco", "rbt", "ascent", "ceiling", "workload", "transmitter",
-		"violation", "bookmark", "surface", "safety stop", "gaschange",
-		"safety stop (voluntary)", "safety stop (mandatory)", "deepstop",
-		"ceiling (safety stop)", "unknown", "divetime", "maxdepth",
-		"OLF", "PO2", "airtime", "rgbm", "heading", "tissue level warning"};
-
-	sample_data_t *sampledata = (sample_data_t *) userdata;
-
-	switch (type) {
-	case SAMPLE_TYPE_TIME:
-		if (sampledata->nsamples++)
-			fprintf (sampledata->fp, "</sample>\n");
-		fprintf (sampledata->fp, "<sample>\n");
-		fprintf (sampledata->fp, "   <time>%02u:%02u</time>\n", value.time / 60, value.time % 60);
-		break;
-	case SAMPLE_TYPE_DEPTH:
-		fprintf (sampledata->fp, "   <depth>%.2f</depth>\n", value.depth);
-		break;
-	case SAMPLE_TYPE_PRESSURE:
-		fprintf (sampledata->fp, "   <pressure tank=\"%u\">%.2f</pressure>\n", value.pressure.tank, value.pressure.value);
-		break;
-	case SAMPLE_TYPE_TEMPERATURE:
-		fprintf (sampledata->fp, "   <temperature>%.2f</temperature>\n", value.temperature);
-		break;
-	case SAMPLE_TYPE_EVENT:
-		fprintf (sampledata->fp, "   <event type=\"%u\" time=\"%u\" flags=\"%u\" value=\"%u\">%s</event>\n",
-			value.event.type, value.event.time, value.event.flags, value.event.value, events[value.event.type]);
-		break;
-	case SAMPLE_TYPE_RBT:
-		fprintf (sampledata->fp, "   <rbt>%u</rbt>\n", value.rbt);
-		break;
-	case SAMPLE_TYPE_HEARTBEAT:
-		fprintf (sampledata->fp, "   <heartbeat>%u</heartbeat>\n", value.heartbeat);
-		break;
-	case SAMPLE_TYPE_BEARING:
-		fprintf (sampledata->fp, "   <bearing>%u</bearing>\n", value.bearing);
-		break;
-	case SAMPLE_TYPE_VENDOR:
-		fprintf (sampledata->fp, "   <vendor type=\"%u\" size=\"%u\">", value.vendor.type, value.vendor.size);
-		for (unsigned int i = 0; i < value.vendor.size; ++i)
-			fprintf (sampledata->fp, "%02X", ((unsigned char *) value.vendor.data)[i]);
-		fprintf (sampledata->fp, "</vendor>\n");
-		break;
-	default:
-		break;
-	}
-}
-
 static parser_status_t
-doparse (FILE *fp, device_data_t *devdata, const unsigned char data[], unsigned int size)
+doparse (FILE *fp, dc_buffer_t *output, device_data_t *devdata, const unsigned char data[], unsigned int size)
 {
 	// Create the parser.
 	message ("Creating the parser.\n");
@@ -351,36 +451,16 @@ doparse (FILE *fp, device_data_t *devdata, const unsigned char data[], unsigned
 		return rc;
 	}
 
-	// Parse the datetime.
-	message ("Parsing the datetime.\n");
-	dc_datetime_t dt = {0};
-	rc = parser_get_datetime (parser, &dt);
-	if (rc != PARSER_STATUS_SUCCESS && rc != PARSER_STATUS_UNSUPPORTED) {
-		WARNING ("Error parsing the datetime.");
-		parser_destroy (parser);
-		return rc;
-	}
-
-	fprintf (fp, "<datetime>%04i-%02i-%02i %02i:%02i:%02i</datetime>\n",
-		dt.year, dt.month, dt.day,
-		dt.hour, dt.minute, dt.second);
-
-	// Initialize the sample data.
-	sample_data_t sampledata = {0};
-	sampledata.nsamples = 0;
-	sampledata.fp = fp;
-
-	// Parse the sample data.
-	message ("Parsing the sample data.\n");
-	rc = parser_samples_foreach (parser, sample_cb, &sampledata);
+	// Export the dive.
+	message ("Exporting the dive.\n");
+	dc_buffer_clear (output);
+	rc = export_dive (parser, g_format, output);
 	if (rc != PARSER_STATUS_SUCCESS) {
-		WARNING ("Error parsing the sample data.");
+		WARNING ("Error exporting the dive.");
 		parser_destroy (parser);
 		return rc;
 	}
-
-	if (sampledata.nsamples)
-		fprintf (fp, "</sample>\n");
+	fwrite (dc_buffer_get_data (output), 1, dc_buffer_get_size (output), fp);
 
 	// Destroy the parser.
 	message ("Destroying the parser.\n");
@@ -399,6 +479,7 @@ event_cb (device_t *device, device_event_t event, const void *data, void *userda
 	const device_progress_t *progress = (device_progress_t *) data;
 	const device_devinfo_t *devinfo = (device_devinfo_t *) data;
 	const device_clock_t *clock = (device_clock_t *) data;
+	const device_stats_t *stats = (device_stats_t *) data;
 
 	device_data_t *devdata = (device_data_t *) userdata;
 
@@ -430,6 +511,22 @@ event_cb (device_t *device, device_event_t event, const void *data, void *userda
 		message ("Event: systime=" DC_TICKS_FORMAT ", devtime=%u\n",
 			clock->systime, clock->devtime);
 		break;
+	case DEVICE_EVENT_STATS:
+		message ("Event: read=%u, written=%u, commands=%u, timeouts=%u, errors=%u, crcerrors=%u\n",
+			stats->nread, stats->nwritten, stats->ncommands,
+			stats->ntimeouts, stats->nerrors, stats->ncrcerrors);
+		message ("Event: retries=%u (timeout=%u, nak=%u, crc=%u)\n",
+			stats->nretries, stats->ntimeoutretries,
+			stats->nnakretries, stats->ncrcretries);
+		for (unsigned int i = 0; i < DEVICE_STATS_NLATENCY; ++i) {
+			if (stats->latency[i] == 0)
+				continue;
+			if (i == DEVICE_STATS_NLATENCY - 1)
+				message ("Event: latency >= %u ms: %u\n", 1u << (i - 1), stats->latency[i]);
+			else
+				message ("Event: latency < %u ms: %u\n", 1u << i, stats->latency[i]);
+		}
+		break;
 	default:
 		break;
 	}
@@ -453,14 +550,17 @@ dive_cb (const unsigned char *data, unsigned int size, const unsigned char *fing
 	}
 
 	if (divedata->fp) {
-		fprintf (divedata->fp, "<dive>\n<number>%u</number>\n<size>%u</size>\n<fingerprint>", divedata->number, size);
-		for (unsigned int i = 0; i < fsize; ++i)
-			fprintf (divedata->fp, "%02X", fingerprint[i]);
-		fprintf (divedata->fp, "</fingerprint>\n");
+		if (g_format == EXPORT_FORMAT_XML) {
+			fprintf (divedata->fp, "<dive>\n<number>%u</number>\n<size>%u</size>\n<fingerprint>", divedata->number, size);
+			for (unsigned int i = 0; i < fsize; ++i)
+				fprintf (divedata->fp, "%02X", fingerprint[i]);
+			fprintf (divedata->fp, "</fingerprint>\n");
+		}
 
-		doparse (divedata->fp, divedata->devdata, data, size);
+		doparse (divedata->fp, divedata->output, divedata->devdata, data, size);
 
-		fprintf (divedata->fp, "</dive>\n");
+		if (g_format == EXPORT_FORMAT_XML)
+			fprintf (divedata->fp, "</dive>\n");
 	}
 
 	return 1;
@@ -501,12 +601,16 @@ usage (const char *filename)
 	fprintf (stderr, "Usage:\n\n");
 	fprintf (stderr, "   %s [options] devname\n\n", filename);
 	fprintf (stderr, "Options:\n\n");
-	fprintf (stderr, "   -b name        Set backend name (required).\n");
+	fprintf (stderr, "   -b name        Set backend name (default: autodetect).\n");
 	fprintf (stderr, "   -f hexdata     Set fingerprint data.\n");
 	fprintf (stderr, "   -l logfile     Set logfile.\n");
 	fprintf (stderr, "   -d filename    Download dives.\n");
 	fprintf (stderr, "   -m filename    Download memory dump.\n");
+	fprintf (stderr, "   -p filename    Previous memory dump (download changes only).\n");
+	fprintf (stderr, "   -r filename    Resume from (and save) a checkpoint file.\n");
 	fprintf (stderr, "   -c cachedir    Set cache directory.\n");
+	fprintf (stderr, "   -t tracefile   Write a trace of the serial traffic.\n");
+	fprintf (stderr, "   -x format      Set the export format (xml, json, csv, binary).\n");
 	fprintf (stderr, "   -h             Show this help message.\n\n");
 #else
 	fprintf (stderr, "Usage:\n\n");
@@ -526,89 +630,143 @@ usage (const char *filename)
 
 
 static device_status_t
-dowork (device_type_t backend, const char *devname, const char *rawfile, const char *xmlfile, int memory, int dives, dc_buffer_t *fingerprint)
+doopen (device_type_t backend, const char *devname, device_t **device)
 {
 	device_status_t rc = DEVICE_STATUS_SUCCESS;
 
-	// Initialize the device data.
-	device_data_t devdata = {0};
-	devdata.backend = backend;
-
-	// Open the device.
 	message ("Opening the device (%s, %s).\n",
 		lookup_name (backend), devname ? devname : "null");
-	device_t *device = NULL;
+
 	switch (backend) {
 	case DEVICE_TYPE_SUUNTO_SOLUTION:
-		rc = suunto_solution_device_open (&device, devname);
+		rc = suunto_solution_device_open (device, devname);
 		break;
 	case DEVICE_TYPE_SUUNTO_EON:
-		rc = suunto_eon_device_open (&device, devname);
+		rc = suunto_eon_device_open (device, devname);
 		break;
 	case DEVICE_TYPE_SUUNTO_VYPER:
-		rc = suunto_vyper_device_open (&device, devname);
+		rc = suunto_vyper_device_open (device, devname);
 		break;
 	case DEVICE_TYPE_SUUNTO_VYPER2:
-		rc = suunto_vyper2_device_open (&device, devname);
+		rc = suunto_vyper2_device_open (device, devname);
 		break;
 	case DEVICE_TYPE_SUUNTO_D9:
-		rc = suunto_d9_device_open (&device, devname);
+		rc = suunto_d9_device_open (device, devname);
 		break;
 	case DEVICE_TYPE_UWATEC_ALADIN:
-		rc = uwatec_aladin_device_open (&device, devname);
+		rc = uwatec_aladin_device_open (device, devname);
 		break;
 	case DEVICE_TYPE_UWATEC_MEMOMOUSE:
-		rc = uwatec_memomouse_device_open (&device, devname);
+		rc = uwatec_memomouse_device_open (device, devname);
 		break;
 	case DEVICE_TYPE_UWATEC_SMART:
-		rc = uwatec_smart_device_open (&device);
+		rc = uwatec_smart_device_open (device);
 		break;
 	case DEVICE_TYPE_REEFNET_SENSUS:
-		rc = reefnet_sensus_device_open (&device, devname);
+		rc = reefnet_sensus_device_open (device, devname);
 		break;
 	case DEVICE_TYPE_REEFNET_SENSUSPRO:
-		rc = reefnet_sensuspro_device_open (&device, devname);
+		rc = reefnet_sensuspro_device_open (device, devname);
 		break;
 	case DEVICE_TYPE_REEFNET_SENSUSULTRA:
-		rc = reefnet_sensusultra_device_open (&device, devname);
+		rc = reefnet_sensusultra_device_open (device, devname);
 		break;
 	case DEVICE_TYPE_OCEANIC_VTPRO:
-		rc = oceanic_vtpro_device_open (&device, devname);
+		rc = oceanic_vtpro_device_open (device, devname);
 		break;
 	case DEVICE_TYPE_OCEANIC_VEO250:
-		rc = oceanic_veo250_device_open (&device, devname);
+		rc = oceanic_veo250_device_open (device, devname);
 		break;
 	case DEVICE_TYPE_OCEANIC_ATOM2:
-		rc = oceanic_atom2_device_open (&device, devname);
+		rc = oceanic_atom2_device_open (device, devname);
 		break;
 	case DEVICE_TYPE_MARES_NEMO:
-		rc = mares_nemo_device_open (&device, devname);
+		rc = mares_nemo_device_open (device, devname);
 		break;
 	case DEVICE_TYPE_MARES_PUCK:
-		rc = mares_puck_device_open (&device, devname);
+		rc = mares_puck_device_open (device, devname);
 		break;
 	case DEVICE_TYPE_HW_OSTC:
-		rc = hw_ostc_device_open (&device, devname);
+		rc = hw_ostc_device_open (device, devname);
 		break;
 	case DEVICE_TYPE_CRESSI_EDY:
-		rc = cressi_edy_device_open (&device, devname);
+		rc = cressi_edy_device_open (device, devname);
 		break;
 	default:
 		rc = DEVICE_STATUS_ERROR;
 		break;
 	}
+
+	return rc;
+}
+
+
+static device_status_t
+autodetect (const char *devname, device_type_t *backend, device_t **device)
+{
+	device_status_t rc = DEVICE_STATUS_UNSUPPORTED;
+
+	// Try the backend that was detected on this port last time first.
+	device_type_t cached = DEVICE_TYPE_NULL;
+	if (g_cachedir) {
+		cached = bkread (g_cachedir, devname);
+		if (cached != DEVICE_TYPE_NULL) {
+			rc = doopen (cached, devname, device);
+			if (rc == DEVICE_STATUS_SUCCESS) {
+				*backend = cached;
+				return rc;
+			}
+		}
+	}
+
+	// Probe all backends that support autodetection.
+	rc = device_open_autodetect (device, devname, backend);
+	if (rc == DEVICE_STATUS_SUCCESS && g_cachedir)
+		bkwrite (g_cachedir, devname, *backend);
+
+	return rc;
+}
+
+
+static device_status_t
+dowork (device_type_t backend, const char *devname, const char *rawfile, const char *xmlfile, int memory, int dives, dc_buffer_t *fingerprint)
+{
+	device_status_t rc = DEVICE_STATUS_SUCCESS;
+
+	// Initialize the device data.
+	device_data_t devdata = {0};
+
+	// Open the device.
+	device_t *device = NULL;
+	if (backend == DEVICE_TYPE_NULL)
+		rc = autodetect (devname, &backend, &device);
+	else
+		rc = doopen (backend, devname, &device);
 	if (rc != DEVICE_STATUS_SUCCESS) {
 		WARNING ("Error opening device.");
 		return rc;
 	}
 
+	devdata.backend = backend;
+
+	// Enable the trace of the serial traffic.
+	if (g_tracefile) {
+		message ("Enabling the trace buffer.\n");
+		rc = device_set_trace (device, 1024 * 1024);
+		if (rc != DEVICE_STATUS_SUCCESS) {
+			WARNING ("Error enabling the trace buffer.");
+			device_close (device);
+			return rc;
+		}
+	}
+
 	// Register the event handler.
 	message ("Registering the event handler.\n");
-	int events = DEVICE_EVENT_WAITING | DEVICE_EVENT_PROGRESS | DEVICE_EVENT_DEVINFO | DEVICE_EVENT_CLOCK;
+	int events = DEVICE_EVENT_WAITING | DEVICE_EVENT_PROGRESS | DEVICE_EVENT_DEVINFO | DEVICE_EVENT_CLOCK | DEVICE_EVENT_STATS;
 	rc = device_set_events (device, events, event_cb, &devdata);
 	if (rc != DEVICE_STATUS_SUCCESS) {
 		WARNING ("Error registering the event handler.");
-		device_close (device);
+		doclose (device);
 		return rc;
 	}
 
@@ -617,44 +775,95 @@ dowork (device_type_t backend, const char *devname, const char *rawfile, const c
 	rc = device_set_cancel (device, cancel_cb, NULL);
 	if (rc != DEVICE_STATUS_SUCCESS) {
 		WARNING ("Error registering the cancellation handler.");
-		device_close (device);
+		doclose (device);
 		return rc;
 	}
 
+	// Restore the progress of a previous (failed) download. The
+	// memory cache keeps track of the progress of this download.
+	if (g_checkpoint) {
+		dc_buffer_t *checkpoint = fileread (g_checkpoint);
+		if (checkpoint) {
+			message ("Restoring the checkpoint.\n");
+			rc = device_set_checkpoint (device, dc_buffer_get_data (checkpoint), dc_buffer_get_size (checkpoint));
+			dc_buffer_free (checkpoint);
+		} else {
+			rc = device_set_cache (device, 1, 0);
+		}
+		if (rc != DEVICE_STATUS_SUCCESS)
+			WARNING ("Error restoring the checkpoint.");
+	}
+
 	// Register the fingerprint data.
 	if (fingerprint) {
 		message ("Registering the fingerprint data.\n");
 		rc = device_set_fingerprint (device, dc_buffer_get_data (fingerprint), dc_buffer_get_size (fingerprint));
 		if (rc != DEVICE_STATUS_SUCCESS) {
 			WARNING ("Error registering the fingerprint data.");
-			device_close (device);
+			doclose (device);
 			return rc;
 		}
 	}
 
-	if (memory) {
-		// Allocate a memory buffer.
-		dc_buffer_t *buffer = dc_buffer_new (0);
+	if (memory && g_previous) {
+		// Read the previous memory dump. This is done before opening
+		// the output file, which is allowed to be the same file.
+		dc_buffer_t *previous = fileread (g_previous);
+		if (previous == NULL) {
+			WARNING ("Error reading the previous memory dump.");
+			doclose (device);
+			return DEVICE_STATUS_IO;
+		}
 
-		// Download the memory dump.
-		message ("Downloading the memory dump.\n");
-		rc = device_dump (device, buffer);
+		// Download the changes since the previous memory dump.
+		message ("Downloading the memory dump (delta).\n");
+		dc_buffer_t *buffer = dc_buffer_new (0);
+		rc = device_dump_delta (device, dc_buffer_get_data (previous), dc_buffer_get_size (previous), buffer);
+		dc_buffer_free (previous);
 		if (rc != DEVICE_STATUS_SUCCESS) {
 			WARNING ("Error downloading the memory dump.");
 			dc_buffer_free (buffer);
-			device_close (device);
+			doclose (device);
 			return rc;
 		}
 
+		// Open the output file.
+		FILE* fp = fopen (rawfile, "wb");
+		if (fp == NULL) {
+			WARNING ("Error opening the output file.");
+			dc_buffer_free (buffer);
+			doclose (device);
+			return DEVICE_STATUS_IO;
+		}
+
 		// Write the memory dump to disk.
+		fwrite (dc_buffer_get_data (buffer), 1, dc_buffer_get_size (buffer), fp);
+
+		// Close the output file.
+		fclose (fp);
+
+		dc_buffer_free (buffer);
+	} else if (memory) {
+		// Open the output file.
 		FILE* fp = fopen (rawfile, "wb");
-		if (fp != NULL) {
-			fwrite (dc_buffer_get_data (buffer), 1, dc_buffer_get_size (buffer), fp);
+		if (fp == NULL) {
+			WARNING ("Error opening the output file.");
+			doclose (device);
+			return DEVICE_STATUS_IO;
+		}
+
+		// Download the memory dump and write it to disk.
+		message ("Downloading the memory dump.\n");
+		rc = device_dump_to (device, device_sink_file, fp);
+		if (rc != DEVICE_STATUS_SUCCESS) {
+			WARNING ("Error downloading the memory dump.");
 			fclose (fp);
+			doclose (device);
+			return rc;
 		}
 
-		// Free the memory buffer.
-		dc_buffer_free (buffer);
+		// Close the output file.
+		fclose (fp);
 	}
 
 	if (dives) {
@@ -665,7 +874,14 @@ dowork (device_type_t backend, const char *devname, const char *rawfile, const c
 		divedata.number = 0;
 
 		// Open the output file.
-		divedata.fp = fopen (xmlfile, "w");
+		divedata.fp = fopen (xmlfile, g_format == EXPORT_FORMAT_BINARY ? "wb" : "w");
+		divedata.output = dc_buffer_new (0);
+
+		// Write the file header.
+		if (divedata.fp) {
+			export_header (g_format, divedata.output);
+			fwrite (dc_buffer_get_data (divedata.output), 1, dc_buffer_get_size (divedata.output), divedata.fp);
+		}
 
 		// Download the dives.
 		message ("Downloading the dives.\n");
@@ -673,8 +889,9 @@ dowork (device_type_t backend, const char *devname, const char *rawfile, const c
 		if (rc != DEVICE_STATUS_SUCCESS) {
 			WARNING ("Error downloading the dives.");
 			dc_buffer_free (divedata.fingerprint);
+			dc_buffer_free (divedata.output);
 			if (divedata.fp) fclose (divedata.fp);
-			device_close (device);
+			doclose (device);
 			return rc;
 		}
 
@@ -683,16 +900,23 @@ dowork (device_type_t backend, const char *devname, const char *rawfile, const c
 			fpwrite (divedata.fingerprint, g_cachedir, devdata.backend, devdata.devinfo.serial);
 		}
 
-		// Free the fingerprint buffer.
+		// Free the fingerprint and output buffers.
 		dc_buffer_free (divedata.fingerprint);
+		dc_buffer_free (divedata.output);
 
 		// Close the output file.
 		if (divedata.fp) fclose (divedata.fp);
 	}
 
+	// Discard the checkpoint of a completed download.
+	if (g_checkpoint) {
+		remove (g_checkpoint);
+		g_checkpoint = NULL;
+	}
+
 	// Close the device.
 	message ("Closing the device.\n");
-	rc = device_close (device);
+	rc = doclose (device);
 	if (rc != DEVICE_STATUS_SUCCESS) {
 		WARNING ("Error closing the device.");
 		return rc;
@@ -717,10 +941,14 @@ main (int argc, char *argv[])
 #ifndef _MSC_VER
 	// Parse command-line options.
 	int opt = 0;
-	while ((opt = getopt (argc, argv, "b:f:l:m:d:c:h")) != -1) {
+	while ((opt = getopt (argc, argv, "b:f:l:m:p:r:d:c:t:x:h")) != -1) {
 		switch (opt) {
 		case 'b':
 			backend = lookup_type (optarg);
+			if (backend == DEVICE_TYPE_NULL) {
+				usage (argv[0]);
+				return EXIT_FAILURE;
+			}
 			break;
 		case 'f':
 			fingerprint = optarg;
@@ -733,6 +961,12 @@ main (int argc, char *argv[])
 			memory = 1;
 			rawfile = optarg;
 			break;
+		case 'p':
+			g_previous = optarg;
+			break;
+		case 'r':
+			g_checkpoint = optarg;
+			break;
 		case 'd':
 			dives = 1;
 			xmlfile = optarg;
@@ -740,6 +974,23 @@ main (int argc, char *argv[])
 		case 'c':
 			g_cachedir = optarg;
 			break;
+		case 't':
+			g_tracefile = optarg;
+			break;
+		case 'x':
+			if (strcmp (optarg, "xml") == 0)
+				g_format = EXPORT_FORMAT_XML;
+			else if (strcmp (optarg, "json") == 0)
+				g_format = EXPORT_FORMAT_JSON;
+			else if (strcmp (optarg, "csv") == 0)
+				g_format = EXPORT_FORMAT_CSV;
+			else if (strcmp (optarg, "binary") == 0)
+				g_format = EXPORT_FORMAT_BINARY;
+			else {
+				usage (argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
 		case '?':
 		case 'h':
 		default:
@@ -756,6 +1007,12 @@ main (int argc, char *argv[])
 
 	if (argc > 2)
 		devname = argv[2];
+
+	// The backend is a mandatory argument.
+	if (backend == DEVICE_TYPE_NULL) {
+		usage (argv[0]);
+		return EXIT_FAILURE;
+	}
 #endif
 
 	// Set the default action.
@@ -764,12 +1021,6 @@ main (int argc, char *argv[])
 		dives = 1;
 	}
 
-	// The backend is a mandatory argument.
-	if (backend == DEVICE_TYPE_NULL) {
-		usage (argv[0]);
-		return EXIT_FAILURE;
-	}
-
 	signal (SIGINT, sighandler);
 
 	message_set_logfile (logfile);
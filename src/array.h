@@ -32,6 +32,18 @@ array_reverse_bytes (unsigned char data[], unsigned int size);
 void
 array_reverse_bits (unsigned char data[], unsigned int size);
 
+unsigned char
+array_reverse_bits_xor_uint8 (unsigned char data[], unsigned int size, unsigned char init);
+
+unsigned short
+array_reverse_bits_add_uint16 (unsigned char data[], unsigned int size, unsigned short init);
+
+void
+array_convert_bin2hex (const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize);
+
+unsigned int
+array_convert_hex2bin (const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize);
+
 int
 array_isequal (const unsigned char data[], unsigned int size, unsigned char value);
 
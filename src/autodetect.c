@@ -0,0 +1,102 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2009 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+
+#include "device-private.h"
+#include "oceanic_common.h"
+#include "suunto_common2.h"
+#include "mares_common.h"
+#include "reefnet_common.h"
+#include "utils.h"
+
+// Receive timeout (in milliseconds) used while probing.
+#define PROBE_TIMEOUT 500
+
+// The candidates are probed in the order of their popularity. The
+// backends with a passive or harmless handshake are tried last, to
+// avoid confusing a device that is waiting for a different protocol.
+static const device_type_t g_candidates[] = {
+	DEVICE_TYPE_OCEANIC_ATOM2,
+	DEVICE_TYPE_OCEANIC_VEO250,
+	DEVICE_TYPE_OCEANIC_VTPRO,
+	DEVICE_TYPE_MARES_PUCK,
+	DEVICE_TYPE_SUUNTO_D9,
+	DEVICE_TYPE_SUUNTO_VYPER2,
+	DEVICE_TYPE_REEFNET_SENSUSULTRA,
+	DEVICE_TYPE_REEFNET_SENSUSPRO,
+	DEVICE_TYPE_REEFNET_SENSUS
+};
+
+
+static device_status_t
+device_open_probe (device_t **out, const char *name, device_type_t type)
+{
+	// Each backend identifies the device with the short timeout,
+	// and restores its normal timeout once the device is found.
+	switch (type) {
+	case DEVICE_TYPE_OCEANIC_ATOM2:
+		return oceanic_atom2_device_open_timeout (out, name, PROBE_TIMEOUT);
+	case DEVICE_TYPE_OCEANIC_VEO250:
+		return oceanic_veo250_device_open_timeout (out, name, PROBE_TIMEOUT);
+	case DEVICE_TYPE_OCEANIC_VTPRO:
+		return oceanic_vtpro_device_open_timeout (out, name, PROBE_TIMEOUT);
+	case DEVICE_TYPE_MARES_PUCK:
+		return mares_puck_device_open_timeout (out, name, PROBE_TIMEOUT);
+	case DEVICE_TYPE_SUUNTO_D9:
+		return suunto_d9_device_open_timeout (out, name, PROBE_TIMEOUT);
+	case DEVICE_TYPE_SUUNTO_VYPER2:
+		return suunto_vyper2_device_open_timeout (out, name, PROBE_TIMEOUT);
+	case DEVICE_TYPE_REEFNET_SENSUSULTRA:
+		return reefnet_sensusultra_device_open_timeout (out, name, PROBE_TIMEOUT);
+	case DEVICE_TYPE_REEFNET_SENSUSPRO:
+		return reefnet_sensuspro_device_open_timeout (out, name, PROBE_TIMEOUT);
+	case DEVICE_TYPE_REEFNET_SENSUS:
+		return reefnet_sensus_device_open_timeout (out, name, PROBE_TIMEOUT);
+	default:
+		return DEVICE_STATUS_UNSUPPORTED;
+	}
+}
+
+
+device_status_t
+device_open_autodetect (device_t **out, const char *name, device_type_t *type)
+{
+	if (out == NULL)
+		return DEVICE_STATUS_ERROR;
+
+	unsigned int ncandidates = sizeof (g_candidates) / sizeof (g_candidates[0]);
+	for (unsigned int i = 0; i < ncandidates; ++i) {
+		device_status_t rc = device_open_probe (out, name, g_candidates[i]);
+		if (rc == DEVICE_STATUS_IO)
+			return rc;
+		if (rc != DEVICE_STATUS_SUCCESS)
+			continue;
+
+		if (type)
+			*type = g_candidates[i];
+
+		return DEVICE_STATUS_SUCCESS;
+	}
+
+	WARNING ("No supported device detected.");
+
+	return DEVICE_STATUS_UNSUPPORTED;
+}
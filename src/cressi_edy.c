@@ -30,6 +30,7 @@
 #include "checksum.h"
 #include "array.h"
 #include "ringbuffer.h"
+#include "rbstream.h"
 
 #define EXITCODE(rc) \
 ( \
@@ -56,6 +57,7 @@ typedef struct cressi_edy_device_t {
 static device_status_t cressi_edy_device_set_fingerprint (device_t *abstract, const unsigned char data[], unsigned int size);
 static device_status_t cressi_edy_device_read (device_t *abstract, unsigned int address, unsigned char data[], unsigned int size);
 static device_status_t cressi_edy_device_dump (device_t *abstract, dc_buffer_t *buffer);
+static device_status_t cressi_edy_device_dump_delta (device_t *abstract, const unsigned char previous[], unsigned int size, dc_buffer_t *buffer);
 static device_status_t cressi_edy_device_foreach (device_t *abstract, dive_callback_t callback, void *userdata);
 static device_status_t cressi_edy_device_close (device_t *abstract);
 
@@ -66,6 +68,8 @@ static const device_backend_t cressi_edy_device_backend = {
 	cressi_edy_device_read, /* read */
 	NULL, /* write */
 	cressi_edy_device_dump, /* dump */
+	NULL, /* dump_to */
+	cressi_edy_device_dump_delta, /* dump_delta */
 	cressi_edy_device_foreach, /* foreach */
 	cressi_edy_device_close /* close */
 };
@@ -177,6 +181,8 @@ cressi_edy_device_open (device_t **out, const char* name)
 
 	// Initialize the base class.
 	device_init (&device->base, &cressi_edy_device_backend);
+	device_set_memory (&device->base, CRESSI_EDY_MEMORY_SIZE, CRESSI_EDY_PACKET_SIZE);
+	device_allow_checkpoint (&device->base);
 
 	// Set the default values.
 	device->port = NULL;
@@ -189,6 +195,9 @@ cressi_edy_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
+	// Record the traffic in the trace buffer.
+	serial_set_trace (device->port, device_get_trace ((device_t *) device));
+
 	// Set the serial communication protocol (1200 8N1).
 	rc = serial_configure (device->port, 1200, 8, SERIAL_PARITY_NONE, 1, SERIAL_FLOWCONTROL_NONE);
 	if (rc == -1) {
@@ -326,11 +335,141 @@ cressi_edy_device_dump (device_t *abstract, dc_buffer_t *buffer)
 		return DEVICE_STATUS_MEMORY;
 	}
 
+	// Pages restored from a checkpoint are only valid as long as the
+	// memory below the profile ringbuffer and the configuration data
+	// remain unchanged.
+	device_range_t areas[2] = {{0, RB_PROFILE_BEGIN}, {0x7F80, CRESSI_EDY_PACKET_SIZE}};
+	device_status_t rc = device_checkpoint_verify (abstract, areas, 2);
+	if (rc != DEVICE_STATUS_SUCCESS)
+		return rc;
+
 	return device_dump_read (abstract, dc_buffer_get_data (buffer),
 		dc_buffer_get_size (buffer), CRESSI_EDY_PACKET_SIZE);
 }
 
 
+static int
+cressi_edy_check_window (const unsigned char config_old[], const unsigned char config_new[], unsigned int eop_old, unsigned int eop_new)
+{
+	unsigned int last_old = config_old[0x7C];
+	unsigned int last_new = config_new[0x7C];
+	if (last_new >= RB_LOGBOOK_END)
+		return 0;
+
+	unsigned int window = ringbuffer_distance (eop_old, eop_new, 0, RB_PROFILE_BEGIN, RB_PROFILE_END);
+
+	// The profiles of all dives added since the previous image must fit
+	// between both end pointers. If not, more than one full ringbuffer
+	// has been written in the meantime.
+	unsigned int total = 0;
+	unsigned int previous = eop_new;
+	unsigned int idx = last_new;
+	while (idx != last_old) {
+		// Get the start of the profile, including its header.
+		unsigned int current = array_uint16_le (config_new + 2 * idx) * PAGESIZE + BASE;
+		if (current < RB_PROFILE_BEGIN || current >= RB_PROFILE_END)
+			return 0;
+		if (current == RB_PROFILE_BEGIN)
+			current = RB_PROFILE_END;
+		current -= PAGESIZE;
+
+		unsigned int length = ringbuffer_distance (current, previous, 1, RB_PROFILE_BEGIN, RB_PROFILE_END);
+		if (ringbuffer_distance (eop_old, current, 0, RB_PROFILE_BEGIN, RB_PROFILE_END) + length > window)
+			return 0;
+
+		total += length;
+		if (total > window)
+			return 0;
+
+		previous = current;
+
+		if (idx == RB_LOGBOOK_BEGIN)
+			idx = RB_LOGBOOK_END;
+		idx--;
+	}
+
+	return 1;
+}
+
+
+static device_status_t
+cressi_edy_device_dump_delta (device_t *abstract, const unsigned char previous[], unsigned int size, dc_buffer_t *buffer)
+{
+	if (! device_is_cressi_edy (abstract))
+		return DEVICE_STATUS_TYPE_MISMATCH;
+
+	if (size != CRESSI_EDY_MEMORY_SIZE)
+		return cressi_edy_device_dump (abstract, buffer);
+
+	// Start from a copy of the previous memory image.
+	if (!dc_buffer_clear (buffer) || !dc_buffer_append (buffer, previous, size)) {
+		WARNING ("Insufficient buffer space available.");
+		return DEVICE_STATUS_MEMORY;
+	}
+
+	unsigned char *data = dc_buffer_get_data (buffer);
+
+	// Enable progress notifications.
+	device_progress_t progress = DEVICE_PROGRESS_INITIALIZER;
+	device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
+
+	// Pages restored from a checkpoint are only valid as long as the
+	// memory below the profile ringbuffer and the configuration data
+	// remain unchanged.
+	device_range_t areas[2] = {{0, RB_PROFILE_BEGIN}, {RB_LOGBOOK_OFFSET, CRESSI_EDY_PACKET_SIZE}};
+	device_status_t rc = device_checkpoint_verify (abstract, areas, 2);
+	if (rc != DEVICE_STATUS_SUCCESS)
+		return rc;
+
+	// Read the configuration data.
+	device_range_t ranges[3] = {{RB_LOGBOOK_OFFSET, CRESSI_EDY_MEMORY_SIZE - RB_LOGBOOK_OFFSET}};
+	rc = device_dump_ranges (abstract, data, ranges, 1, CRESSI_EDY_PACKET_SIZE, &progress);
+	if (rc != DEVICE_STATUS_SUCCESS) {
+		WARNING ("Failed to read the configuration data.");
+		return rc;
+	}
+
+	const unsigned char *config_old = previous + RB_LOGBOOK_OFFSET;
+	const unsigned char *config_new = data + RB_LOGBOOK_OFFSET;
+
+	// Get the most recent logbook item and the profile pointers.
+	unsigned int last = config_old[0x7C];
+	unsigned int eop_old = array_uint16_le (config_old + 0x7E) * PAGESIZE + BASE;
+	unsigned int eop_new = array_uint16_le (config_new + 0x7E) * PAGESIZE + BASE;
+
+	// The contents of the memory below the profile
+	// ringbuffer is unknown, and always downloaded again.
+	unsigned int n = 0;
+	ranges[n].address = 0;
+	ranges[n].size = RB_PROFILE_BEGIN;
+	n++;
+
+	// The entire profile ringbuffer is downloaded again for invalid
+	// pointers, when the most recent dive of the previous image is no
+	// longer present (e.g. a different device), when the configuration
+	// has changed without the end pointer moving, or when the new dives
+	// do not fit between both end pointers. Otherwise only the area
+	// between both end pointers has changed, with a safety margin.
+	if (last >= RB_LOGBOOK_END ||
+		eop_old < RB_PROFILE_BEGIN || eop_old >= RB_PROFILE_END ||
+		eop_new < RB_PROFILE_BEGIN || eop_new >= RB_PROFILE_END ||
+		memcmp (config_old + 2 * last, config_new + 2 * last, 2) != 0 ||
+		(eop_old == eop_new && memcmp (config_old, config_new, CRESSI_EDY_PACKET_SIZE) != 0) ||
+		!cressi_edy_check_window (config_old, config_new, eop_old, eop_new))
+	{
+		ranges[n].address = RB_PROFILE_BEGIN;
+		ranges[n].size = RB_PROFILE_END - RB_PROFILE_BEGIN;
+		n++;
+	} else {
+		unsigned int first = ringbuffer_decrement (eop_old, CRESSI_EDY_PACKET_SIZE, RB_PROFILE_BEGIN, RB_PROFILE_END);
+		unsigned int end   = ringbuffer_increment (eop_new, PAGESIZE, RB_PROFILE_BEGIN, RB_PROFILE_END);
+		n += device_range_ringbuffer (ranges + n, first, end, RB_PROFILE_BEGIN, RB_PROFILE_END);
+	}
+
+	return device_dump_ranges (abstract, data, ranges, n, CRESSI_EDY_PACKET_SIZE, &progress);
+}
+
+
 static device_status_t
 cressi_edy_device_foreach (device_t *abstract, dive_callback_t callback, void *userdata)
 {
@@ -342,9 +481,19 @@ cressi_edy_device_foreach (device_t *abstract, dive_callback_t callback, void *u
 		(RB_PROFILE_END - RB_PROFILE_BEGIN);
 	device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
 
+	// Pages restored from a checkpoint are only valid as long as the
+	// memory below the profile ringbuffer and the configuration data
+	// remain unchanged.
+	device_range_t areas[2] = {{0, RB_PROFILE_BEGIN}, {0x7F80, CRESSI_EDY_PACKET_SIZE}};
+	device_status_t rc = device_checkpoint_verify (abstract, areas, 2);
+	if (rc != DEVICE_STATUS_SUCCESS) {
+		WARNING ("Cannot verify the checkpoint.");
+		return rc;
+	}
+
 	// Read the configuration data.
 	unsigned char config[CRESSI_EDY_PACKET_SIZE] = {0};
-	device_status_t rc = cressi_edy_device_read (abstract, 0x7F80, config, sizeof (config));
+	rc = device_read (abstract, 0x7F80, config, sizeof (config));
 	if (rc != DEVICE_STATUS_SUCCESS) {
 		WARNING ("Failed to read the configuration data.");
 		return rc;
@@ -365,13 +514,23 @@ cressi_edy_device_foreach (device_t *abstract, dive_callback_t callback, void *u
 	unsigned int eop = array_uint16_le (config + 0x7E) * PAGESIZE + BASE;
 
 	// Memory buffer for the profile data.
-	unsigned char buffer[RB_PROFILE_END - RB_PROFILE_BEGIN] = {0};
+	unsigned char *buffer = device_get_scratch (abstract, RB_PROFILE_END - RB_PROFILE_BEGIN);
+	if (buffer == NULL)
+		return DEVICE_STATUS_MEMORY;
+
+	// Create the ringbuffer stream. The device only supports reading
+	// whole packets, so short packets are padded.
+	rbstream_t *rbstream = NULL;
+	rc = rbstream_new (&rbstream, abstract, PAGESIZE, CRESSI_EDY_PACKET_SIZE, CRESSI_EDY_PACKET_SIZE,
+		RB_PROFILE_BEGIN, RB_PROFILE_END, eop, RB_PROFILE_END - RB_PROFILE_BEGIN);
+	if (rc != DEVICE_STATUS_SUCCESS) {
+		WARNING ("Failed to create the ringbuffer stream.");
+		return rc;
+	}
 
-	unsigned int available = 0;
 	unsigned int offset = RB_PROFILE_END - RB_PROFILE_BEGIN;
 
 	unsigned int previous = eop;
-	unsigned int address = previous;
 
 	unsigned int idx = last;
 	for (unsigned int i = 0; i < count; ++i) {
@@ -385,43 +544,39 @@ cressi_edy_device_foreach (device_t *abstract, dive_callback_t callback, void *u
 
 		// Get the profile length.
 		unsigned int length = ringbuffer_distance (current, previous, 1, RB_PROFILE_BEGIN, RB_PROFILE_END);
+		if (length > offset) {
+			WARNING ("Unexpected profile size.");
+			rbstream_free (rbstream);
+			return DEVICE_STATUS_ERROR;
+		}
+
+		// Move to the start of the current profile.
+		offset -= length;
 
-		unsigned nbytes = available;
-		while (nbytes < length) {
-			if (address == RB_PROFILE_BEGIN)
-				address = RB_PROFILE_END;
-			address -= CRESSI_EDY_PACKET_SIZE;
-			offset -= CRESSI_EDY_PACKET_SIZE;
-
-			// Read the memory page.
-			rc = cressi_edy_device_read (abstract, address, buffer + offset, CRESSI_EDY_PACKET_SIZE);
-			if (rc != DEVICE_STATUS_SUCCESS) {
-				WARNING ("Failed to read the memory page.");
-				return rc;
-			}
-
-			// Update and emit a progress event.
-			progress.current += CRESSI_EDY_PACKET_SIZE;
-			device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
-
-			nbytes += CRESSI_EDY_PACKET_SIZE;
+		// Read the profile data.
+		rc = rbstream_read (rbstream, &progress, buffer + offset, length);
+		if (rc != DEVICE_STATUS_SUCCESS) {
+			WARNING ("Failed to read the memory page.");
+			rbstream_free (rbstream);
+			return rc;
 		}
 
-		available = nbytes - length;
 		previous = current;
 
-		unsigned char *p = buffer + offset + available;
+		unsigned char *p = buffer + offset;
 
 		if (memcmp (p, device->fingerprint, sizeof (device->fingerprint)) == 0)
-			return DEVICE_STATUS_SUCCESS;
+			break;
 
 		if (callback && !callback (p, length, p, sizeof (device->fingerprint), userdata))
-			return DEVICE_STATUS_SUCCESS;
+			break;
 
 		if (idx == RB_LOGBOOK_BEGIN)
 			idx = RB_LOGBOOK_END;
 		idx--;
 	}
 
+	rbstream_free (rbstream);
+
 	return DEVICE_STATUS_SUCCESS;
 }
@@ -25,6 +25,7 @@
 #include <limits.h>
 
 #include "device.h"
+#include "trace.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -34,8 +35,17 @@ extern "C" {
 
 struct device_t;
 struct device_backend_t;
+struct device_cache_t;
 
 typedef struct device_backend_t device_backend_t;
+typedef struct device_cache_t device_cache_t;
+
+typedef device_status_t (*device_probe_callback_t) (device_t *device, unsigned int size, int *accepted);
+
+typedef struct device_range_t {
+	unsigned int address;
+	unsigned int size;
+} device_range_t;
 
 struct device_t {
 	const device_backend_t *backend;
@@ -46,6 +56,20 @@ struct device_t {
 	// Cancellation support.
 	device_cancel_callback_t cancel_callback;
 	void *cancel_userdata;
+	// Memory cache.
+	unsigned int memsize;
+	unsigned int pagesize;
+	device_cache_t *cache;
+	int checkpoint;
+	// Traffic trace.
+	trace_t trace;
+	// Scratch memory.
+	unsigned char *scratch;
+	unsigned int scratchsize;
+	int scratchowned;
+	// Transfer statistics.
+	device_stats_t stats;
+	int statscause;
 };
 
 struct device_backend_t {
@@ -61,6 +85,10 @@ struct device_backend_t {
 
 	device_status_t (*dump) (device_t *device, dc_buffer_t *buffer);
 
+	device_status_t (*dump_to) (device_t *device, device_sink_callback_t callback, void *userdata);
+
+	device_status_t (*dump_delta) (device_t *device, const unsigned char previous[], unsigned int size, dc_buffer_t *buffer);
+
 	device_status_t (*foreach) (device_t *device, dive_callback_t callback, void *userdata);
 
 	device_status_t (*close) (device_t *device);
@@ -75,9 +103,51 @@ device_event_emit (device_t *device, device_event_t event, const void *data);
 int
 device_is_cancelled (device_t *device);
 
+void
+device_set_memory (device_t *device, unsigned int memsize, unsigned int pagesize);
+
+void
+device_allow_checkpoint (device_t *device);
+
+trace_t *
+device_get_trace (device_t *device);
+
+unsigned char *
+device_get_scratch (device_t *device, unsigned int size);
+
+device_status_t
+device_probe_size (device_t *device, unsigned int minimum, unsigned int maximum, device_probe_callback_t callback);
+
+device_status_t
+device_checkpoint_verify (device_t *device, const device_range_t ranges[], unsigned int count);
+
+unsigned int
+device_stats_begin (device_t *device);
+
+void
+device_stats_end (device_t *device, unsigned int timestamp);
+
+void
+device_stats_error (device_t *device, device_status_t status);
+
+void
+device_stats_nak (device_t *device);
+
+void
+device_stats_crc (device_t *device);
+
+unsigned int
+device_stats_retry (device_t *device);
+
 device_status_t
 device_dump_read (device_t *device, unsigned char data[], unsigned int size, unsigned int blocksize);
 
+unsigned int
+device_range_ringbuffer (device_range_t ranges[], unsigned int first, unsigned int last, unsigned int begin, unsigned int end);
+
+device_status_t
+device_dump_ranges (device_t *device, unsigned char data[], device_range_t ranges[], unsigned int count, unsigned int blocksize, device_progress_t *progress);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
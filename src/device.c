@@ -20,9 +20,53 @@
  */
 
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "device-private.h"
+#include "array.h"
+#include "utils.h"
+
+#define DEVICE_DUMP_WINDOW 1024
+
+// The cause of the last error, which is attributed to the next retry.
+// Timeouts are recognized from the status code, but a NAK answer and a
+// corrupted answer are both protocol errors, and are reported by the
+// backend separately.
+
+#define STATS_CAUSE_OTHER   0
+#define STATS_CAUSE_TIMEOUT 1
+#define STATS_CAUSE_NAK     2
+#define STATS_CAUSE_CRC     3
+
+// The memory cache keeps a copy of all the memory pages that have been
+// read from the device. Repeated read requests for the same pages are
+// served from this copy, without any communication with the device.
+// Missing pages are read with some extra pages in the direction of the
+// traversal, to anticipate the next read request.
+//
+// Pages restored from a checkpoint are kept apart from the pages read in
+// the current session, until the backend has verified the checkpoint. Any
+// restored page that is requested before that time is verified against
+// the memory contents first.
+
+#define PAGE_MISSING  0
+#define PAGE_VALID    1
+#define PAGE_RESTORED 2
+
+struct device_cache_t {
+	// Number of read-ahead pages.
+	unsigned int readahead;
+	// Address of the previous read request.
+	unsigned int address;
+	// Pages restored from a checkpoint, not yet verified.
+	int restored;
+	// Page status (one byte per page).
+	unsigned char *valid;
+	// Memory image.
+	unsigned char data[];
+};
 
 
 void
@@ -36,6 +80,57 @@ device_init (device_t *device, const device_backend_t *backend)
 
 	device->cancel_callback = NULL;
 	device->cancel_userdata = NULL;
+
+	device->memsize = 0;
+	device->pagesize = 0;
+	device->cache = NULL;
+	device->checkpoint = 0;
+
+	trace_init (&device->trace);
+
+	device->scratch = NULL;
+	device->scratchsize = 0;
+	device->scratchowned = 0;
+
+	memset (&device->stats, 0, sizeof (device->stats));
+	device->statscause = STATS_CAUSE_OTHER;
+}
+
+
+void
+device_set_memory (device_t *device, unsigned int memsize, unsigned int pagesize)
+{
+	assert (device != NULL);
+	assert (pagesize != 0);
+	assert (memsize % pagesize == 0);
+
+	// Discard the contents of the cache. If the memory layout is
+	// unchanged, the cache remains enabled, but all pages are marked
+	// as invalid. Otherwise the cache is disabled.
+	if (device->cache && memsize == device->memsize && pagesize == device->pagesize) {
+		memset (device->cache->valid, 0, memsize / pagesize);
+		device->cache->restored = 0;
+	} else {
+		free (device->cache);
+		device->cache = NULL;
+	}
+
+	device->memsize = memsize;
+	device->pagesize = pagesize;
+}
+
+
+void
+device_allow_checkpoint (device_t *device)
+{
+	assert (device != NULL);
+	assert (device->memsize != 0);
+
+	// Only backends that verify the checkpoint, with
+	// device_checkpoint_verify, support checkpoints. For all
+	// other backends, the restored pages would have to be
+	// verified page by page, and would be of no use.
+	device->checkpoint = 1;
 }
 
 
@@ -89,6 +184,538 @@ device_set_fingerprint (device_t *device, const unsigned char data[], unsigned i
 }
 
 
+device_status_t
+device_set_cache (device_t *device, int enable, unsigned int readahead)
+{
+	if (device == NULL)
+		return DEVICE_STATUS_UNSUPPORTED;
+
+	if (!enable) {
+		free (device->cache);
+		device->cache = NULL;
+		return DEVICE_STATUS_SUCCESS;
+	}
+
+	if (device->backend->read == NULL || device->memsize == 0)
+		return DEVICE_STATUS_UNSUPPORTED;
+
+	// Allocate memory for the memory image and the page status.
+	if (device->cache == NULL) {
+		unsigned int npages = device->memsize / device->pagesize;
+		device_cache_t *cache = (device_cache_t *) malloc (sizeof (device_cache_t) + device->memsize + npages);
+		if (cache == NULL) {
+			WARNING ("Failed to allocate memory.");
+			return DEVICE_STATUS_MEMORY;
+		}
+
+		cache->address = 0;
+		cache->restored = 0;
+		cache->valid = cache->data + device->memsize;
+		memset (cache->valid, 0, npages);
+
+		device->cache = cache;
+	}
+
+	// Convert the read-ahead size to a number of pages.
+	device->cache->readahead = (readahead + device->pagesize - 1) / device->pagesize;
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
+// A checkpoint contains the pages of the memory cache, preceded by a small
+// header with the device type and memory layout (each a 32 bit little
+// endian value) and the page status (one byte per page). Only the valid
+// pages are stored, in order of increasing address.
+
+#define CHECKPOINT_HEADER_SIZE 12
+
+static void
+checkpoint_put_uint32 (unsigned char data[], unsigned int value)
+{
+	data[0] = (value      ) & 0xFF;
+	data[1] = (value >>  8) & 0xFF;
+	data[2] = (value >> 16) & 0xFF;
+	data[3] = (value >> 24) & 0xFF;
+}
+
+
+device_status_t
+device_get_checkpoint (device_t *device, dc_buffer_t *buffer)
+{
+	if (device == NULL || buffer == NULL)
+		return DEVICE_STATUS_UNSUPPORTED;
+
+	device_cache_t *cache = device->cache;
+	if (cache == NULL || !device->checkpoint)
+		return DEVICE_STATUS_UNSUPPORTED;
+
+	unsigned int pagesize = device->pagesize;
+	unsigned int npages = device->memsize / pagesize;
+
+	unsigned int nvalid = 0;
+	for (unsigned int i = 0; i < npages; ++i) {
+		if (cache->valid[i])
+			nvalid++;
+	}
+
+	// Allocate the required amount of memory.
+	if (!dc_buffer_clear (buffer) ||
+		!dc_buffer_resize (buffer, CHECKPOINT_HEADER_SIZE + npages + nvalid * pagesize)) {
+		WARNING ("Insufficient buffer space available.");
+		return DEVICE_STATUS_MEMORY;
+	}
+
+	unsigned char *data = dc_buffer_get_data (buffer);
+	checkpoint_put_uint32 (data + 0, device->backend->type);
+	checkpoint_put_uint32 (data + 4, device->memsize);
+	checkpoint_put_uint32 (data + 8, pagesize);
+
+	unsigned char *p = data + CHECKPOINT_HEADER_SIZE + npages;
+	for (unsigned int i = 0; i < npages; ++i) {
+		data[CHECKPOINT_HEADER_SIZE + i] = (cache->valid[i] != PAGE_MISSING);
+		if (cache->valid[i]) {
+			memcpy (p, cache->data + i * pagesize, pagesize);
+			p += pagesize;
+		}
+	}
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
+device_status_t
+device_set_checkpoint (device_t *device, const unsigned char data[], unsigned int size)
+{
+	if (device == NULL)
+		return DEVICE_STATUS_UNSUPPORTED;
+
+	if (device->backend->read == NULL || !device->checkpoint)
+		return DEVICE_STATUS_UNSUPPORTED;
+
+	if (data == NULL || size < CHECKPOINT_HEADER_SIZE)
+		return DEVICE_STATUS_ERROR;
+
+	// Verify the device type and the memory layout.
+	if (array_uint32_le (data) != device->backend->type)
+		return DEVICE_STATUS_TYPE_MISMATCH;
+
+	unsigned int pagesize = device->pagesize;
+	unsigned int npages = device->memsize / pagesize;
+	if (array_uint32_le (data + 4) != device->memsize ||
+		array_uint32_le (data + 8) != pagesize ||
+		size < CHECKPOINT_HEADER_SIZE + npages)
+	{
+		WARNING ("Unexpected checkpoint layout.");
+		return DEVICE_STATUS_ERROR;
+	}
+
+	const unsigned char *valid = data + CHECKPOINT_HEADER_SIZE;
+
+	unsigned int nvalid = 0;
+	for (unsigned int i = 0; i < npages; ++i) {
+		if (valid[i])
+			nvalid++;
+	}
+
+	if (size != CHECKPOINT_HEADER_SIZE + npages + nvalid * pagesize) {
+		WARNING ("Unexpected checkpoint size.");
+		return DEVICE_STATUS_ERROR;
+	}
+
+	// The restored pages are kept in the memory cache,
+	// which is enabled automatically when necessary.
+	if (device->cache == NULL) {
+		device_status_t rc = device_set_cache (device, 1, 0);
+		if (rc != DEVICE_STATUS_SUCCESS)
+			return rc;
+	}
+
+	device_cache_t *cache = device->cache;
+
+	const unsigned char *p = valid + npages;
+	for (unsigned int i = 0; i < npages; ++i) {
+		if (valid[i]) {
+			memcpy (cache->data + i * pagesize, p, pagesize);
+			p += pagesize;
+		}
+		cache->valid[i] = (valid[i] ? PAGE_RESTORED : PAGE_MISSING);
+	}
+
+	cache->restored = (nvalid != 0);
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
+trace_t *
+device_get_trace (device_t *device)
+{
+	assert (device != NULL);
+
+	return &device->trace;
+}
+
+
+device_status_t
+device_set_trace (device_t *device, unsigned int size)
+{
+	if (device == NULL)
+		return DEVICE_STATUS_UNSUPPORTED;
+
+	// Allocate (or release) the trace buffer. Any
+	// previously recorded traffic is discarded.
+	if (trace_resize (&device->trace, size) != 0) {
+		WARNING ("Failed to allocate memory.");
+		return DEVICE_STATUS_MEMORY;
+	}
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
+device_status_t
+device_dump_trace (device_t *device, dc_buffer_t *buffer)
+{
+	if (device == NULL)
+		return DEVICE_STATUS_UNSUPPORTED;
+
+	// Allocate the required amount of memory.
+	if (!dc_buffer_resize (buffer, device->trace.length)) {
+		WARNING ("Insufficient buffer space available.");
+		return DEVICE_STATUS_MEMORY;
+	}
+
+	trace_read (&device->trace, dc_buffer_get_data (buffer), dc_buffer_get_size (buffer));
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
+device_status_t
+device_set_scratch (device_t *device, unsigned char data[], unsigned int size)
+{
+	if (device == NULL)
+		return DEVICE_STATUS_UNSUPPORTED;
+
+	// Release the current scratch memory.
+	if (device->scratchowned)
+		free (device->scratch);
+
+	// Use the memory supplied by the caller, or fall back to memory
+	// allocated by the library on the next use. The caller memory
+	// must remain valid until the device is closed or replaced.
+	if (data && size) {
+		device->scratch = data;
+		device->scratchsize = size;
+	} else {
+		device->scratch = NULL;
+		device->scratchsize = 0;
+	}
+	device->scratchowned = 0;
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
+device_status_t
+device_get_stats (device_t *device, device_stats_t *stats)
+{
+	if (device == NULL || stats == NULL)
+		return DEVICE_STATUS_UNSUPPORTED;
+
+	*stats = device->stats;
+
+	// The byte counters are maintained by the trace.
+	stats->nread = device->trace.nread;
+	stats->nwritten = device->trace.nwritten;
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
+unsigned int
+device_stats_begin (device_t *device)
+{
+	assert (device != NULL);
+
+	device->stats.ncommands++;
+	device->statscause = STATS_CAUSE_OTHER;
+
+	return trace_now ();
+}
+
+
+void
+device_stats_end (device_t *device, unsigned int timestamp)
+{
+	assert (device != NULL);
+
+	// Update the latency histogram. Bin n counts the round-trip
+	// times below 2^n ms, and the last bin collects all the rest.
+	// Only the final attempt of a command is included, because the
+	// timestamp is restarted on each retry.
+	unsigned int elapsed = trace_now () - timestamp;
+	unsigned int n = 0;
+	while (n < DEVICE_STATS_NLATENCY - 1 && elapsed >= (1u << n))
+		n++;
+
+	device->stats.latency[n]++;
+}
+
+
+void
+device_stats_error (device_t *device, device_status_t status)
+{
+	assert (device != NULL);
+
+	if (status == DEVICE_STATUS_TIMEOUT) {
+		device->stats.ntimeouts++;
+		device->statscause = STATS_CAUSE_TIMEOUT;
+	} else if (status == DEVICE_STATUS_PROTOCOL) {
+		device->stats.nerrors++;
+	}
+}
+
+
+void
+device_stats_nak (device_t *device)
+{
+	assert (device != NULL);
+
+	device->statscause = STATS_CAUSE_NAK;
+}
+
+
+void
+device_stats_crc (device_t *device)
+{
+	assert (device != NULL);
+
+	device->stats.ncrcerrors++;
+	device->statscause = STATS_CAUSE_CRC;
+}
+
+
+unsigned int
+device_stats_retry (device_t *device)
+{
+	assert (device != NULL);
+
+	device->stats.nretries++;
+
+	switch (device->statscause) {
+	case STATS_CAUSE_TIMEOUT:
+		device->stats.ntimeoutretries++;
+		break;
+	case STATS_CAUSE_NAK:
+		device->stats.nnakretries++;
+		break;
+	case STATS_CAUSE_CRC:
+		device->stats.ncrcretries++;
+		break;
+	default:
+		break;
+	}
+
+	device->statscause = STATS_CAUSE_OTHER;
+
+	// The retry starts a new attempt, which is timed separately.
+	return trace_now ();
+}
+
+
+unsigned char *
+device_get_scratch (device_t *device, unsigned int size)
+{
+	assert (device != NULL);
+
+	// The scratch memory is allocated on first use and kept until the
+	// device is closed, so it can be reused for all subsequent calls.
+	if (size > device->scratchsize) {
+		unsigned char *scratch = (unsigned char *) malloc (size);
+		if (scratch == NULL) {
+			WARNING ("Failed to allocate memory.");
+			return NULL;
+		}
+
+		if (device->scratchowned)
+			free (device->scratch);
+
+		device->scratch = scratch;
+		device->scratchsize = size;
+		device->scratchowned = 1;
+	}
+
+	return device->scratch;
+}
+
+
+static device_status_t
+device_cache_verify (device_t *device, unsigned int first, unsigned int last)
+{
+	device_cache_t *cache = device->cache;
+
+	unsigned int pagesize = device->pagesize;
+
+	// Get the range of restored pages.
+	while (first < last && cache->valid[first] != PAGE_RESTORED)
+		first++;
+	while (last > first && cache->valid[last - 1] != PAGE_RESTORED)
+		last--;
+	if (first == last)
+		return DEVICE_STATUS_SUCCESS;
+
+	unsigned int length = (last - first) * pagesize;
+	unsigned char *data = (unsigned char *) malloc (length);
+	if (data == NULL) {
+		WARNING ("Failed to allocate memory.");
+		return DEVICE_STATUS_MEMORY;
+	}
+
+	// Read the pages directly from the device, bypassing the cache.
+	device_status_t rc = device->backend->read (device, first * pagesize, data, length);
+	if (rc != DEVICE_STATUS_SUCCESS) {
+		free (data);
+		return rc;
+	}
+
+	// If any of the restored pages no longer matches the memory contents,
+	// the checkpoint is out of date (or belongs to another device) and
+	// all restored pages are discarded.
+	for (unsigned int i = first; i < last; ++i) {
+		if (cache->valid[i] == PAGE_RESTORED && memcmp (cache->data + i * pagesize,
+			data + (i - first) * pagesize, pagesize) != 0)
+		{
+			WARNING ("Discarding an outdated checkpoint.");
+			unsigned int npages = device->memsize / pagesize;
+			for (unsigned int j = 0; j < npages; ++j) {
+				if (cache->valid[j] == PAGE_RESTORED)
+					cache->valid[j] = PAGE_MISSING;
+			}
+			cache->restored = 0;
+			break;
+		}
+	}
+
+	memcpy (cache->data + first * pagesize, data, length);
+	memset (cache->valid + first, PAGE_VALID, last - first);
+
+	free (data);
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
+static device_status_t
+device_cache_read (device_t *device, unsigned int address, unsigned char data[], unsigned int size)
+{
+	device_cache_t *cache = device->cache;
+
+	unsigned int pagesize = device->pagesize;
+	unsigned int npages = device->memsize / pagesize;
+
+	// Get the range of pages that contain the requested data.
+	unsigned int first = address / pagesize;
+	unsigned int last = (address + size + pagesize - 1) / pagesize;
+
+	// Restored pages are never returned unverified.
+	if (cache->restored) {
+		device_status_t rc = device_cache_verify (device, first, last);
+		if (rc != DEVICE_STATUS_SUCCESS)
+			return rc;
+	}
+
+	// Detect the direction of the traversal.
+	int backwards = (address < cache->address);
+	cache->address = address;
+
+	unsigned int page = first;
+	while (page < last) {
+		// Skip pages that are already present.
+		if (cache->valid[page]) {
+			page++;
+			continue;
+		}
+
+		// Find the end of the missing pages.
+		unsigned int begin = page, end = page;
+		while (end < last && !cache->valid[end])
+			end++;
+
+		// Append the read-ahead pages.
+		unsigned int n = 0;
+		if (backwards && begin == first) {
+			while (n < cache->readahead && begin > 0 && !cache->valid[begin - 1]) {
+				begin--;
+				n++;
+			}
+		} else if (!backwards && end == last) {
+			while (n < cache->readahead && end < npages && !cache->valid[end]) {
+				end++;
+				n++;
+			}
+		}
+
+		// Read the missing pages.
+		device_status_t rc = device->backend->read (device, begin * pagesize,
+			cache->data + begin * pagesize, (end - begin) * pagesize);
+		if (rc != DEVICE_STATUS_SUCCESS)
+			return rc;
+
+		memset (cache->valid + begin, PAGE_VALID, end - begin);
+
+		page = end;
+	}
+
+	memcpy (data, cache->data + address, size);
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
+device_status_t
+device_checkpoint_verify (device_t *device, const device_range_t ranges[], unsigned int count)
+{
+	assert (device != NULL);
+
+	device_cache_t *cache = device->cache;
+	if (cache == NULL || !cache->restored)
+		return DEVICE_STATUS_SUCCESS;
+
+	unsigned int pagesize = device->pagesize;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		if (ranges[i].size == 0)
+			continue;
+
+		// Get the range of pages that contain the requested data.
+		unsigned int first = ranges[i].address / pagesize;
+		unsigned int last = (ranges[i].address + ranges[i].size + pagesize - 1) / pagesize;
+		if (last > device->memsize / pagesize)
+			return DEVICE_STATUS_ERROR;
+
+		device_status_t rc = device_cache_verify (device, first, last);
+		if (rc != DEVICE_STATUS_SUCCESS)
+			return rc;
+
+		if (!cache->restored)
+			return DEVICE_STATUS_SUCCESS;
+	}
+
+	// The memory areas that change whenever new data is stored are
+	// unchanged, so the remaining restored pages are still valid.
+	unsigned int npages = device->memsize / pagesize;
+	for (unsigned int i = 0; i < npages; ++i) {
+		if (cache->valid[i] == PAGE_RESTORED)
+			cache->valid[i] = PAGE_VALID;
+	}
+	cache->restored = 0;
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
 device_status_t
 device_version (device_t *device, unsigned char data[], unsigned int size)
 {
@@ -111,6 +738,10 @@ device_read (device_t *device, unsigned int address, unsigned char data[], unsig
 	if (device->backend->read == NULL)
 		return DEVICE_STATUS_UNSUPPORTED;
 
+	// Requests outside the memory area bypass the cache.
+	if (device->cache && address <= device->memsize && size <= device->memsize - address)
+		return device_cache_read (device, address, data, size);
+
 	return device->backend->read (device, address, data, size);
 }
 
@@ -124,7 +755,90 @@ device_write (device_t *device, unsigned int address, const unsigned char data[]
 	if (device->backend->write == NULL)
 		return DEVICE_STATUS_UNSUPPORTED;
 
-	return device->backend->write (device, address, data, size);
+	device_status_t rc = device->backend->write (device, address, data, size);
+	if (rc != DEVICE_STATUS_SUCCESS)
+		return rc;
+
+	// Keep the cached memory image up to date.
+	if (device->cache && address < device->memsize) {
+		unsigned int len = device->memsize - address;
+		if (len > size)
+			len = size;
+		memcpy (device->cache->data + address, data, len);
+	}
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
+device_status_t
+device_write_changed (device_t *device, unsigned int address, const unsigned char data[], unsigned int size)
+{
+	if (device == NULL)
+		return DEVICE_STATUS_UNSUPPORTED;
+
+	if (device->backend->read == NULL || device->backend->write == NULL || device->memsize == 0)
+		return DEVICE_STATUS_UNSUPPORTED;
+
+	// The data is compared in units of the cache page size. This is not
+	// necessarily the write granularity of the device, which is left to
+	// the write function of the backend.
+	unsigned int pagesize = device->pagesize;
+	if (address % pagesize != 0 || size % pagesize != 0 ||
+		address > device->memsize || size > device->memsize - address)
+		return DEVICE_STATUS_ERROR;
+
+	// The current contents are processed with a small fixed size window,
+	// containing a whole number of pages. When the memory cache is enabled,
+	// pages that are already present are not read again.
+	unsigned char current[DEVICE_DUMP_WINDOW];
+	unsigned int window = sizeof (current) - sizeof (current) % pagesize;
+	assert (window != 0);
+
+	// Enable progress notifications.
+	device_progress_t progress = DEVICE_PROGRESS_INITIALIZER;
+	progress.maximum = size;
+	device_event_emit (device, DEVICE_EVENT_PROGRESS, &progress);
+
+	unsigned int nbytes = 0;
+	while (nbytes < size) {
+		// Calculate the window size.
+		unsigned int len = size - nbytes;
+		if (len > window)
+			len = window;
+
+		// Read the current contents. Pages restored from a checkpoint
+		// are verified against the memory contents before comparing.
+		device_status_t rc = device_read (device, address + nbytes, current, len);
+		if (rc != DEVICE_STATUS_SUCCESS)
+			return rc;
+
+		// Write only the pages that differ from the current contents,
+		// combining consecutive pages into a single write request.
+		unsigned int offset = 0;
+		while (offset < len) {
+			if (memcmp (current + offset, data + nbytes + offset, pagesize) == 0) {
+				offset += pagesize;
+				continue;
+			}
+
+			unsigned int begin = offset;
+			while (offset < len && memcmp (current + offset, data + nbytes + offset, pagesize) != 0)
+				offset += pagesize;
+
+			rc = device_write (device, address + nbytes + begin, data + nbytes + begin, offset - begin);
+			if (rc != DEVICE_STATUS_SUCCESS)
+				return rc;
+		}
+
+		// Update and emit a progress event.
+		progress.current += len;
+		device_event_emit (device, DEVICE_EVENT_PROGRESS, &progress);
+
+		nbytes += len;
+	}
+
+	return DEVICE_STATUS_SUCCESS;
 }
 
 
@@ -141,6 +855,142 @@ device_dump (device_t *device, dc_buffer_t *buffer)
 }
 
 
+device_status_t
+device_dump_to (device_t *device, device_sink_callback_t callback, void *userdata)
+{
+	if (device == NULL || callback == NULL)
+		return DEVICE_STATUS_UNSUPPORTED;
+
+	if (device->backend->dump_to)
+		return device->backend->dump_to (device, callback, userdata);
+
+	// Devices with random access to their memory are downloaded with
+	// a small fixed size window, which is passed to the sink directly.
+	// Pages restored from a checkpoint are downloaded with the backend
+	// dump instead, which verifies only the areas that change whenever
+	// new data is stored, rather than each page separately.
+	int restored = (device->cache && device->cache->restored);
+	if (device->backend->read && device->memsize && !(restored && device->backend->dump)) {
+		unsigned char data[DEVICE_DUMP_WINDOW];
+
+		// The window contains a whole number of pages.
+		unsigned int window = sizeof (data) - sizeof (data) % device->pagesize;
+		assert (window != 0);
+
+		// Enable progress notifications.
+		device_progress_t progress = DEVICE_PROGRESS_INITIALIZER;
+		progress.maximum = device->memsize;
+		device_event_emit (device, DEVICE_EVENT_PROGRESS, &progress);
+
+		unsigned int nbytes = 0;
+		while (nbytes < device->memsize) {
+			// Calculate the window size.
+			unsigned int len = device->memsize - nbytes;
+			if (len > window)
+				len = window;
+
+			// Read the window.
+			device_status_t rc = device_read (device, nbytes, data, len);
+			if (rc != DEVICE_STATUS_SUCCESS)
+				return rc;
+
+			// Update and emit a progress event.
+			progress.current += len;
+			device_event_emit (device, DEVICE_EVENT_PROGRESS, &progress);
+
+			// Pass the window to the sink.
+			if (!callback (nbytes, data, len, userdata)) {
+				WARNING ("Failed to write the data.");
+				return DEVICE_STATUS_ERROR;
+			}
+
+			nbytes += len;
+		}
+
+		return DEVICE_STATUS_SUCCESS;
+	}
+
+	// For all other devices, the entire memory image is downloaded
+	// into a memory buffer first.
+	if (device->backend->dump == NULL)
+		return DEVICE_STATUS_UNSUPPORTED;
+
+	dc_buffer_t *buffer = dc_buffer_new (0);
+	if (buffer == NULL) {
+		WARNING ("Failed to allocate memory.");
+		return DEVICE_STATUS_MEMORY;
+	}
+
+	device_status_t rc = device->backend->dump (device, buffer);
+	if (rc != DEVICE_STATUS_SUCCESS) {
+		dc_buffer_free (buffer);
+		return rc;
+	}
+
+	if (!callback (0, dc_buffer_get_data (buffer), dc_buffer_get_size (buffer), userdata)) {
+		WARNING ("Failed to write the data.");
+		dc_buffer_free (buffer);
+		return DEVICE_STATUS_ERROR;
+	}
+
+	dc_buffer_free (buffer);
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
+device_status_t
+device_dump_delta (device_t *device, const unsigned char previous[], unsigned int size, dc_buffer_t *buffer)
+{
+	if (device == NULL)
+		return DEVICE_STATUS_UNSUPPORTED;
+
+	// Without a previous memory image, or a backend that knows which
+	// parts of the memory can have changed, there is nothing to gain
+	// and a full memory dump is performed instead.
+	if (device->backend->dump_delta == NULL || previous == NULL || size == 0)
+		return device_dump (device, buffer);
+
+	return device->backend->dump_delta (device, previous, size, buffer);
+}
+
+
+int
+device_sink_buffer (unsigned int offset, const unsigned char data[], unsigned int size, void *userdata)
+{
+	dc_buffer_t *buffer = (dc_buffer_t *) userdata;
+
+	// Grow the buffer when necessary.
+	if (offset + size > dc_buffer_get_size (buffer)) {
+		if (!dc_buffer_resize (buffer, offset + size))
+			return 0;
+	}
+
+	if (size)
+		memcpy (dc_buffer_get_data (buffer) + offset, data, size);
+
+	return 1;
+}
+
+
+int
+device_sink_file (unsigned int offset, const unsigned char data[], unsigned int size, void *userdata)
+{
+	FILE *fp = (FILE *) userdata;
+
+	if (fp == NULL)
+		return 0;
+
+	if (fseek (fp, offset, SEEK_SET) != 0)
+		return 0;
+
+	if (fwrite (data, 1, size, fp) != size)
+		return 0;
+
+	return 1;
+}
+
+
 device_status_t
 device_dump_read (device_t *device, unsigned char data[], unsigned int size, unsigned int blocksize)
 {
@@ -163,7 +1013,7 @@ device_dump_read (device_t *device, unsigned char data[], unsigned int size, uns
 			len = blocksize;
 
 		// Read the packet.
-		device_status_t rc = device->backend->read (device, nbytes, data + nbytes, len);
+		device_status_t rc = device_read (device, nbytes, data + nbytes, len);
 		if (rc != DEVICE_STATUS_SUCCESS)
 			return rc;
 
@@ -178,6 +1028,133 @@ device_dump_read (device_t *device, unsigned char data[], unsigned int size, uns
 }
 
 
+device_status_t
+device_probe_size (device_t *device, unsigned int minimum, unsigned int maximum, device_probe_callback_t callback)
+{
+	assert (device != NULL);
+	assert (callback != NULL);
+
+	// Try the largest size first, and halve it until the device
+	// accepts a request. Below the minimum size, the backend uses
+	// its default size, which is always supported.
+	for (unsigned int size = maximum; size > minimum; size /= 2) {
+		int accepted = 0;
+		device_status_t rc = callback (device, size, &accepted);
+		if (rc != DEVICE_STATUS_SUCCESS)
+			return rc;
+
+		if (accepted)
+			break;
+	}
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
+unsigned int
+device_range_ringbuffer (device_range_t ranges[], unsigned int first, unsigned int last, unsigned int begin, unsigned int end)
+{
+	if (first == last)
+		return 0;
+
+	if (first < last) {
+		ranges[0].address = first;
+		ranges[0].size = last - first;
+		return 1;
+	}
+
+	// The area crosses the ringbuffer wrap point.
+	ranges[0].address = first;
+	ranges[0].size = end - first;
+	ranges[1].address = begin;
+	ranges[1].size = last - begin;
+
+	return 2;
+}
+
+
+device_status_t
+device_dump_ranges (device_t *device, unsigned char data[], device_range_t ranges[], unsigned int count, unsigned int blocksize, device_progress_t *progress)
+{
+	if (device == NULL)
+		return DEVICE_STATUS_UNSUPPORTED;
+
+	if (device->backend->read == NULL)
+		return DEVICE_STATUS_UNSUPPORTED;
+
+	unsigned int pagesize = device->pagesize ? device->pagesize : 1;
+
+	// Align the ranges to page boundaries, and sort them
+	// in order of increasing address.
+	for (unsigned int i = 0; i < count; ++i) {
+		device_range_t range = ranges[i];
+		unsigned int end = range.address + range.size;
+		range.address -= range.address % pagesize;
+		end += (pagesize - end % pagesize) % pagesize;
+		if (device->memsize && end > device->memsize)
+			end = device->memsize;
+		range.size = end - range.address;
+
+		unsigned int j = i;
+		while (j > 0 && ranges[j - 1].address > range.address) {
+			ranges[j] = ranges[j - 1];
+			j--;
+		}
+		ranges[j] = range;
+	}
+
+	// Merge overlapping and adjacent ranges.
+	unsigned int n = 0, total = 0;
+	for (unsigned int i = 0; i < count; ++i) {
+		if (ranges[i].size == 0)
+			continue;
+
+		if (n > 0 && ranges[i].address <= ranges[n - 1].address + ranges[n - 1].size) {
+			unsigned int end = ranges[i].address + ranges[i].size;
+			if (end > ranges[n - 1].address + ranges[n - 1].size) {
+				total += end - (ranges[n - 1].address + ranges[n - 1].size);
+				ranges[n - 1].size = end - ranges[n - 1].address;
+			}
+		} else {
+			ranges[n++] = ranges[i];
+			total += ranges[i].size;
+		}
+	}
+
+	// Update and emit a progress event.
+	if (progress) {
+		progress->maximum = progress->current + total;
+		device_event_emit (device, DEVICE_EVENT_PROGRESS, progress);
+	}
+
+	for (unsigned int i = 0; i < n; ++i) {
+		unsigned int nbytes = 0;
+		while (nbytes < ranges[i].size) {
+			// Calculate the packet size.
+			unsigned int len = ranges[i].size - nbytes;
+			if (len > blocksize)
+				len = blocksize;
+
+			// Read the packet.
+			unsigned int address = ranges[i].address + nbytes;
+			device_status_t rc = device_read (device, address, data + address, len);
+			if (rc != DEVICE_STATUS_SUCCESS)
+				return rc;
+
+			// Update and emit a progress event.
+			if (progress) {
+				progress->current += len;
+				device_event_emit (device, DEVICE_EVENT_PROGRESS, progress);
+			}
+
+			nbytes += len;
+		}
+	}
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
 device_status_t
 device_foreach (device_t *device, dive_callback_t callback, void *userdata)
 {
@@ -200,6 +1177,23 @@ device_close (device_t *device)
 	if (device->backend->close == NULL)
 		return DEVICE_STATUS_UNSUPPORTED;
 
+	// Report the final transfer statistics.
+	device_stats_t stats;
+	device_get_stats (device, &stats);
+	device_event_emit (device, DEVICE_EVENT_STATS, &stats);
+
+	// Free the cache, the trace and the scratch buffer, because
+	// the backend releases the device structure.
+	free (device->cache);
+	device->cache = NULL;
+
+	trace_resize (&device->trace, 0);
+
+	if (device->scratchowned)
+		free (device->scratch);
+	device->scratch = NULL;
+	device->scratchsize = 0;
+
 	return device->backend->close (device);
 }
 
@@ -225,6 +1219,9 @@ device_event_emit (device_t *device, device_event_t event, const void *data)
 	case DEVICE_EVENT_CLOCK:
 		assert (data != NULL);
 		break;
+	case DEVICE_EVENT_STATS:
+		assert (data != NULL);
+		break;
 	default:
 		break;
 	}
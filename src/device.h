@@ -67,9 +67,12 @@ typedef enum device_event_t {
 	DEVICE_EVENT_WAITING = (1 << 0),
 	DEVICE_EVENT_PROGRESS = (1 << 1),
 	DEVICE_EVENT_DEVINFO = (1 << 2),
-	DEVICE_EVENT_CLOCK = (1 << 3)
+	DEVICE_EVENT_CLOCK = (1 << 3),
+	DEVICE_EVENT_STATS = (1 << 4)
 } device_event_t;
 
+#define DEVICE_STATS_NLATENCY 12
+
 typedef struct device_t device_t;
 
 typedef struct device_progress_t {
@@ -88,12 +91,30 @@ typedef struct device_clock_t {
 	dc_ticks_t systime;
 } device_clock_t;
 
+typedef struct device_stats_t {
+	unsigned int nread;
+	unsigned int nwritten;
+	unsigned int ncommands;
+	unsigned int nretries;
+	unsigned int ntimeoutretries;
+	unsigned int nnakretries;
+	unsigned int ncrcretries;
+	unsigned int ntimeouts;
+	unsigned int nerrors;
+	unsigned int ncrcerrors;
+	unsigned int latency[DEVICE_STATS_NLATENCY];
+} device_stats_t;
+
 typedef int (*device_cancel_callback_t) (void *userdata);
 
 typedef void (*device_event_callback_t) (device_t *device, device_event_t event, const void *data, void *userdata);
 
 typedef int (*dive_callback_t) (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata);
 
+typedef int (*device_sink_callback_t) (unsigned int offset, const unsigned char data[], unsigned int size, void *userdata);
+
+device_status_t device_open_autodetect (device_t **device, const char *name, device_type_t *type);
+
 device_type_t device_get_type (device_t *device);
 
 device_status_t device_set_cancel (device_t *device, device_cancel_callback_t callback, void *userdata);
@@ -102,14 +123,38 @@ device_status_t device_set_events (device_t *device, unsigned int events, device
 
 device_status_t device_set_fingerprint (device_t *device, const unsigned char data[], unsigned int size);
 
+device_status_t device_set_cache (device_t *device, int enable, unsigned int readahead);
+
+device_status_t device_get_checkpoint (device_t *device, dc_buffer_t *buffer);
+
+device_status_t device_set_checkpoint (device_t *device, const unsigned char data[], unsigned int size);
+
+device_status_t device_set_trace (device_t *device, unsigned int size);
+
+device_status_t device_set_scratch (device_t *device, unsigned char data[], unsigned int size);
+
+device_status_t device_dump_trace (device_t *device, dc_buffer_t *buffer);
+
+device_status_t device_get_stats (device_t *device, device_stats_t *stats);
+
 device_status_t device_version (device_t *device, unsigned char data[], unsigned int size);
 
 device_status_t device_read (device_t *device, unsigned int address, unsigned char data[], unsigned int size);
 
 device_status_t device_write (device_t *device, unsigned int address, const unsigned char data[], unsigned int size);
 
+device_status_t device_write_changed (device_t *device, unsigned int address, const unsigned char data[], unsigned int size);
+
 device_status_t device_dump (device_t *device, dc_buffer_t *buffer);
 
+device_status_t device_dump_to (device_t *device, device_sink_callback_t callback, void *userdata);
+
+device_status_t device_dump_delta (device_t *device, const unsigned char previous[], unsigned int size, dc_buffer_t *buffer);
+
+int device_sink_buffer (unsigned int offset, const unsigned char data[], unsigned int size, void *userdata);
+
+int device_sink_file (unsigned int offset, const unsigned char data[], unsigned int size, void *userdata);
+
 device_status_t device_foreach (device_t *device, dive_callback_t callback, void *userdata);
 
 device_status_t device_close (device_t *device);
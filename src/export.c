@@ -0,0 +1,680 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2009 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdio.h>	// snprintf
+#include <string.h>	// memcpy, strlen
+
+#include "export.h"
+#include "utils.h"
+
+#define BINARY_VERSION 1
+#define BINARY_DIVE 0x80
+
+//
+// The output is collected in a small staging buffer, which is appended
+// to the destination buffer when it is full. All numbers are formatted
+// with integer arithmetic only, to be independent of the current locale
+// and to avoid the overhead of the printf family of functions.
+//
+
+typedef struct export_writer_t {
+	dc_buffer_t *buffer;
+	unsigned int size;
+	int error;
+	unsigned char data[512];
+} export_writer_t;
+
+typedef struct export_t {
+	export_writer_t writer;
+	export_format_t format;
+	unsigned int time;
+	unsigned int nsamples;
+	char datetime[80];
+} export_t;
+
+static const char *g_events[] = {
+	"none", "deco", "rbt", "ascent", "ceiling", "workload", "transmitter",
+	"violation", "bookmark", "surface", "safety stop", "gaschange",
+	"safety stop (voluntary)", "safety stop (mandatory)", "deepstop",
+	"ceiling (safety stop)", "unknown", "divetime", "maxdepth",
+	"OLF", "PO2", "airtime", "rgbm", "heading", "tissue level warning"};
+
+static const char *g_types[] = {
+	"time", "depth", "pressure", "temperature", "event",
+	"rbt", "heartbeat", "bearing", "vendor"};
+
+
+static void
+export_flush (export_writer_t *writer)
+{
+	if (writer->size == 0)
+		return;
+
+	if (!dc_buffer_append (writer->buffer, writer->data, writer->size))
+		writer->error = 1;
+
+	writer->size = 0;
+}
+
+
+static void
+export_write (export_writer_t *writer, const void *data, unsigned int size)
+{
+	if (writer->size + size > sizeof (writer->data)) {
+		export_flush (writer);
+
+		// Large blocks are appended directly.
+		if (size > sizeof (writer->data)) {
+			if (!dc_buffer_append (writer->buffer, (const unsigned char *) data, size))
+				writer->error = 1;
+			return;
+		}
+	}
+
+	memcpy (writer->data + writer->size, data, size);
+	writer->size += size;
+}
+
+
+static void
+export_string (export_writer_t *writer, const char *string)
+{
+	export_write (writer, string, strlen (string));
+}
+
+
+static void
+export_uint (export_writer_t *writer, unsigned int value, unsigned int width)
+{
+	char digits[16];
+	unsigned int n = sizeof (digits);
+
+	// Convert the digits from right to left, padded
+	// with zeros to the minimum width.
+	do {
+		digits[--n] = '0' + value % 10;
+		value /= 10;
+	} while (value || sizeof (digits) - n < width);
+
+	export_write (writer, digits + n, sizeof (digits) - n);
+}
+
+
+static void
+export_int (export_writer_t *writer, int value, unsigned int width)
+{
+	if (value < 0) {
+		export_write (writer, "-", 1);
+		export_uint (writer, 0u - (unsigned int) value, width ? width - 1 : 0);
+	} else {
+		export_uint (writer, value, width);
+	}
+}
+
+
+static void
+export_fixed (export_writer_t *writer, double value)
+{
+	// Large values (and NaN or infinity) do not fit into
+	// the integer conversion. They are never reported by
+	// the parsers, and are left to the C library.
+	if (!(value > -1E13 && value < 1E13)) {
+		char tmp[400];
+		int n = snprintf (tmp, sizeof (tmp), "%.2f", value);
+		if (n > 0 && n < (int) sizeof (tmp))
+			export_write (writer, tmp, n);
+		return;
+	}
+
+	int negative = (value < 0.0 || (value == 0.0 && 1.0 / value < 0.0));
+	if (negative)
+		value = -value;
+
+	// Scale the value to hundredths. The rounding error of the
+	// multiplication is recovered exactly (Dekker's product), to
+	// round in the same way as printf does for the exact value.
+	double product = value * 100.0;
+	double c = 134217729.0 * value;
+	double hi = c - (c - value);
+	double lo = value - hi;
+	double error = (hi * 100.0 - product) + lo * 100.0;
+
+	unsigned long long n = (unsigned long long) product;
+	double fraction = product - (double) n;
+	if (fraction > 0.5 || (fraction == 0.5 &&
+		(error > 0.0 || (error == 0.0 && (n & 1)))))
+		n++;
+
+	char digits[24];
+	unsigned int i = sizeof (digits);
+	digits[--i] = '0' + n % 10; n /= 10;
+	digits[--i] = '0' + n % 10; n /= 10;
+	digits[--i] = '.';
+	do {
+		digits[--i] = '0' + n % 10;
+		n /= 10;
+	} while (n);
+	if (negative)
+		digits[--i] = '-';
+
+	export_write (writer, digits + i, sizeof (digits) - i);
+}
+
+
+static void
+export_hex (export_writer_t *writer, const unsigned char data[], unsigned int size)
+{
+	static const char hex[] = "0123456789ABCDEF";
+
+	for (unsigned int i = 0; i < size; ++i) {
+		char digits[2] = {hex[data[i] >> 4], hex[data[i] & 0x0F]};
+		export_write (writer, digits, sizeof (digits));
+	}
+}
+
+
+static void
+export_uint16_le (export_writer_t *writer, unsigned int value)
+{
+	unsigned char data[2] = {
+		(value      ) & 0xFF,
+		(value >>  8) & 0xFF};
+	export_write (writer, data, sizeof (data));
+}
+
+
+static void
+export_uint32_le (export_writer_t *writer, unsigned int value)
+{
+	unsigned char data[4] = {
+		(value      ) & 0xFF,
+		(value >>  8) & 0xFF,
+		(value >> 16) & 0xFF,
+		(value >> 24) & 0xFF};
+	export_write (writer, data, sizeof (data));
+}
+
+
+static void
+export_fixed_le (export_writer_t *writer, double value)
+{
+	// Fixed point number with a resolution of 1/1000.
+	double scaled = value * 1000.0;
+	int n = (int) (scaled < 0.0 ? scaled - 0.5 : scaled + 0.5);
+	export_uint32_le (writer, (unsigned int) n);
+}
+
+
+static void
+export_record (export_writer_t *writer, unsigned int type, unsigned int size)
+{
+	unsigned char data[3] = {type, size & 0xFF, (size >> 8) & 0xFF};
+	export_write (writer, data, sizeof (data));
+}
+
+
+static const char *
+export_event_name (unsigned int type)
+{
+	if (type >= sizeof (g_events) / sizeof (g_events[0]))
+		return "unknown";
+
+	return g_events[type];
+}
+
+
+static void
+export_sample_xml (export_t *exp, parser_sample_type_t type, parser_sample_value_t value)
+{
+	export_writer_t *writer = &exp->writer;
+
+	switch (type) {
+	case SAMPLE_TYPE_TIME:
+		if (exp->nsamples++)
+			export_string (writer, "</sample>\n");
+		export_string (writer, "<sample>\n   <time>");
+		export_uint (writer, value.time / 60, 2);
+		export_write (writer, ":", 1);
+		export_uint (writer, value.time % 60, 2);
+		export_string (writer, "</time>\n");
+		break;
+	case SAMPLE_TYPE_DEPTH:
+		export_string (writer, "   <depth>");
+		export_fixed (writer, value.depth);
+		export_string (writer, "</depth>\n");
+		break;
+	case SAMPLE_TYPE_PRESSURE:
+		export_string (writer, "   <pressure tank=\"");
+		export_uint (writer, value.pressure.tank, 0);
+		export_string (writer, "\">");
+		export_fixed (writer, value.pressure.value);
+		export_string (writer, "</pressure>\n");
+		break;
+	case SAMPLE_TYPE_TEMPERATURE:
+		export_string (writer, "   <temperature>");
+		export_fixed (writer, value.temperature);
+		export_string (writer, "</temperature>\n");
+		break;
+	case SAMPLE_TYPE_EVENT:
+		export_string (writer, "   <event type=\"");
+		export_uint (writer, value.event.type, 0);
+		export_string (writer, "\" time=\"");
+		export_uint (writer, value.event.time, 0);
+		export_string (writer, "\" flags=\"");
+		export_uint (writer, value.event.flags, 0);
+		export_string (writer, "\" value=\"");
+		export_uint (writer, value.event.value, 0);
+		export_string (writer, "\">");
+		export_string (writer, export_event_name (value.event.type));
+		export_string (writer, "</event>\n");
+		break;
+	case SAMPLE_TYPE_RBT:
+		export_string (writer, "   <rbt>");
+		export_uint (writer, value.rbt, 0);
+		export_string (writer, "</rbt>\n");
+		break;
+	case SAMPLE_TYPE_HEARTBEAT:
+		export_string (writer, "   <heartbeat>");
+		export_uint (writer, value.heartbeat, 0);
+		export_string (writer, "</heartbeat>\n");
+		break;
+	case SAMPLE_TYPE_BEARING:
+		export_string (writer, "   <bearing>");
+		export_uint (writer, value.bearing, 0);
+		export_string (writer, "</bearing>\n");
+		break;
+	case SAMPLE_TYPE_VENDOR:
+		export_string (writer, "   <vendor type=\"");
+		export_uint (writer, value.vendor.type, 0);
+		export_string (writer, "\" size=\"");
+		export_uint (writer, value.vendor.size, 0);
+		export_string (writer, "\">");
+		export_hex (writer, (const unsigned char *) value.vendor.data, value.vendor.size);
+		export_string (writer, "</vendor>\n");
+		break;
+	default:
+		break;
+	}
+}
+
+
+static void
+export_sample_json (export_t *exp, parser_sample_type_t type, parser_sample_value_t value)
+{
+	export_writer_t *writer = &exp->writer;
+
+	if (type == SAMPLE_TYPE_TIME)
+		exp->time = value.time;
+
+	// Every sample is written as a separate object,
+	// tagged with the time of the current sample.
+	if (exp->nsamples++)
+		export_write (writer, ",", 1);
+	export_string (writer, "{\"time\":");
+	export_uint (writer, exp->time, 0);
+
+	switch (type) {
+	case SAMPLE_TYPE_DEPTH:
+		export_string (writer, ",\"depth\":");
+		export_fixed (writer, value.depth);
+		break;
+	case SAMPLE_TYPE_PRESSURE:
+		export_string (writer, ",\"tank\":");
+		export_uint (writer, value.pressure.tank, 0);
+		export_string (writer, ",\"pressure\":");
+		export_fixed (writer, value.pressure.value);
+		break;
+	case SAMPLE_TYPE_TEMPERATURE:
+		export_string (writer, ",\"temperature\":");
+		export_fixed (writer, value.temperature);
+		break;
+	case SAMPLE_TYPE_EVENT:
+		export_string (writer, ",\"event\":{\"type\":");
+		export_uint (writer, value.event.type, 0);
+		export_string (writer, ",\"time\":");
+		export_uint (writer, value.event.time, 0);
+		export_string (writer, ",\"flags\":");
+		export_uint (writer, value.event.flags, 0);
+		export_string (writer, ",\"value\":");
+		export_uint (writer, value.event.value, 0);
+		export_string (writer, ",\"name\":\"");
+		export_string (writer, export_event_name (value.event.type));
+		export_string (writer, "\"}");
+		break;
+	case SAMPLE_TYPE_RBT:
+		export_string (writer, ",\"rbt\":");
+		export_uint (writer, value.rbt, 0);
+		break;
+	case SAMPLE_TYPE_HEARTBEAT:
+		export_string (writer, ",\"heartbeat\":");
+		export_uint (writer, value.heartbeat, 0);
+		break;
+	case SAMPLE_TYPE_BEARING:
+		export_string (writer, ",\"bearing\":");
+		export_uint (writer, value.bearing, 0);
+		break;
+	case SAMPLE_TYPE_VENDOR:
+		export_string (writer, ",\"vendor\":{\"type\":");
+		export_uint (writer, value.vendor.type, 0);
+		export_string (writer, ",\"data\":\"");
+		export_hex (writer, (const unsigned char *) value.vendor.data, value.vendor.size);
+		export_string (writer, "\"}");
+		break;
+	default:
+		break;
+	}
+
+	export_write (writer, "}", 1);
+}
+
+
+static void
+export_sample_csv (export_t *exp, parser_sample_type_t type, parser_sample_value_t value)
+{
+	export_writer_t *writer = &exp->writer;
+
+	// The time is not written as a separate row,
+	// but is included in all the other rows.
+	if (type == SAMPLE_TYPE_TIME) {
+		exp->time = value.time;
+		return;
+	}
+
+	if (type >= sizeof (g_types) / sizeof (g_types[0]))
+		return;
+
+	// Columns: datetime, time, type, subtype, offset, flags, value.
+	export_string (writer, exp->datetime);
+	export_write (writer, ",", 1);
+	export_uint (writer, exp->time, 0);
+	export_write (writer, ",", 1);
+	export_string (writer, g_types[type]);
+	export_write (writer, ",", 1);
+
+	switch (type) {
+	case SAMPLE_TYPE_DEPTH:
+		export_string (writer, ",,,");
+		export_fixed (writer, value.depth);
+		break;
+	case SAMPLE_TYPE_PRESSURE:
+		export_uint (writer, value.pressure.tank, 0);
+		export_string (writer, ",,,");
+		export_fixed (writer, value.pressure.value);
+		break;
+	case SAMPLE_TYPE_TEMPERATURE:
+		export_string (writer, ",,,");
+		export_fixed (writer, value.temperature);
+		break;
+	case SAMPLE_TYPE_EVENT:
+		export_string (writer, export_event_name (value.event.type));
+		export_write (writer, ",", 1);
+		export_uint (writer, value.event.time, 0);
+		export_write (writer, ",", 1);
+		export_uint (writer, value.event.flags, 0);
+		export_write (writer, ",", 1);
+		export_uint (writer, value.event.value, 0);
+		break;
+	case SAMPLE_TYPE_RBT:
+		export_string (writer, ",,,");
+		export_uint (writer, value.rbt, 0);
+		break;
+	case SAMPLE_TYPE_HEARTBEAT:
+		export_string (writer, ",,,");
+		export_uint (writer, value.heartbeat, 0);
+		break;
+	case SAMPLE_TYPE_BEARING:
+		export_string (writer, ",,,");
+		export_uint (writer, value.bearing, 0);
+		break;
+	case SAMPLE_TYPE_VENDOR:
+		export_uint (writer, value.vendor.type, 0);
+		export_string (writer, ",,,");
+		export_hex (writer, (const unsigned char *) value.vendor.data, value.vendor.size);
+		break;
+	default:
+		break;
+	}
+
+	export_write (writer, "\n", 1);
+}
+
+
+static void
+export_sample_binary (export_t *exp, parser_sample_type_t type, parser_sample_value_t value)
+{
+	export_writer_t *writer = &exp->writer;
+
+	// Every sample is written as a record with a one byte type and
+	// a two byte length, followed by the little endian payload.
+	switch (type) {
+	case SAMPLE_TYPE_TIME:
+		export_record (writer, type, 4);
+		export_uint32_le (writer, value.time);
+		break;
+	case SAMPLE_TYPE_DEPTH:
+		export_record (writer, type, 4);
+		export_fixed_le (writer, value.depth);
+		break;
+	case SAMPLE_TYPE_PRESSURE:
+		export_record (writer, type, 6);
+		export_uint16_le (writer, value.pressure.tank);
+		export_fixed_le (writer, value.pressure.value);
+		break;
+	case SAMPLE_TYPE_TEMPERATURE:
+		export_record (writer, type, 4);
+		export_fixed_le (writer, value.temperature);
+		break;
+	case SAMPLE_TYPE_EVENT:
+		export_record (writer, type, 16);
+		export_uint32_le (writer, value.event.type);
+		export_uint32_le (writer, value.event.time);
+		export_uint32_le (writer, value.event.flags);
+		export_uint32_le (writer, value.event.value);
+		break;
+	case SAMPLE_TYPE_RBT:
+		export_record (writer, type, 4);
+		export_uint32_le (writer, value.rbt);
+		break;
+	case SAMPLE_TYPE_HEARTBEAT:
+		export_record (writer, type, 4);
+		export_uint32_le (writer, value.heartbeat);
+		break;
+	case SAMPLE_TYPE_BEARING:
+		export_record (writer, type, 4);
+		export_uint32_le (writer, value.bearing);
+		break;
+	case SAMPLE_TYPE_VENDOR:
+		if (value.vendor.size > 0xFFFF - 2) {
+			WARNING ("Vendor data too large.");
+			break;
+		}
+		export_record (writer, type, value.vendor.size + 2);
+		export_uint16_le (writer, value.vendor.type);
+		export_write (writer, value.vendor.data, value.vendor.size);
+		break;
+	default:
+		break;
+	}
+}
+
+
+static void
+export_sample (parser_sample_type_t type, parser_sample_value_t value, void *userdata)
+{
+	export_t *exp = (export_t *) userdata;
+
+	switch (exp->format) {
+	case EXPORT_FORMAT_XML:
+		export_sample_xml (exp, type, value);
+		break;
+	case EXPORT_FORMAT_JSON:
+		export_sample_json (exp, type, value);
+		break;
+	case EXPORT_FORMAT_CSV:
+		export_sample_csv (exp, type, value);
+		break;
+	case EXPORT_FORMAT_BINARY:
+		export_sample_binary (exp, type, value);
+		break;
+	default:
+		break;
+	}
+}
+
+
+static void
+export_datetime (export_writer_t *writer, const dc_datetime_t *dt)
+{
+	export_int (writer, dt->year, 4);
+	export_write (writer, "-", 1);
+	export_int (writer, dt->month, 2);
+	export_write (writer, "-", 1);
+	export_int (writer, dt->day, 2);
+	export_write (writer, " ", 1);
+	export_int (writer, dt->hour, 2);
+	export_write (writer, ":", 1);
+	export_int (writer, dt->minute, 2);
+	export_write (writer, ":", 1);
+	export_int (writer, dt->second, 2);
+}
+
+
+parser_status_t
+export_header (export_format_t format, dc_buffer_t *buffer)
+{
+	if (buffer == NULL)
+		return PARSER_STATUS_ERROR;
+
+	const unsigned char magic[] = {'D', 'C', 'E', 'X', BINARY_VERSION};
+	const char columns[] = "datetime,time,type,subtype,offset,flags,value\n";
+
+	int success = 1;
+	switch (format) {
+	case EXPORT_FORMAT_XML:
+	case EXPORT_FORMAT_JSON:
+		break;
+	case EXPORT_FORMAT_CSV:
+		success = dc_buffer_append (buffer, (const unsigned char *) columns, sizeof (columns) - 1);
+		break;
+	case EXPORT_FORMAT_BINARY:
+		success = dc_buffer_append (buffer, magic, sizeof (magic));
+		break;
+	default:
+		return PARSER_STATUS_ERROR;
+	}
+
+	if (!success) {
+		WARNING ("Insufficient buffer space available.");
+		return PARSER_STATUS_MEMORY;
+	}
+
+	return PARSER_STATUS_SUCCESS;
+}
+
+
+parser_status_t
+export_dive (parser_t *parser, export_format_t format, dc_buffer_t *buffer)
+{
+	if (parser == NULL || buffer == NULL)
+		return PARSER_STATUS_ERROR;
+
+	if (format != EXPORT_FORMAT_XML && format != EXPORT_FORMAT_JSON &&
+		format != EXPORT_FORMAT_CSV && format != EXPORT_FORMAT_BINARY)
+		return PARSER_STATUS_ERROR;
+
+	// Parse the datetime. Not all backends support it.
+	dc_datetime_t dt = {0};
+	parser_status_t rc = parser_get_datetime (parser, &dt);
+	if (rc != PARSER_STATUS_SUCCESS && rc != PARSER_STATUS_UNSUPPORTED)
+		return rc;
+
+	// The dive is appended to the existing contents of the buffer.
+	size_t offset = dc_buffer_get_size (buffer);
+
+	export_t exp;
+	exp.writer.buffer = buffer;
+	exp.writer.size = 0;
+	exp.writer.error = 0;
+	exp.format = format;
+	exp.time = 0;
+	exp.nsamples = 0;
+
+	export_writer_t *writer = &exp.writer;
+
+	// Write the dive header.
+	switch (format) {
+	case EXPORT_FORMAT_XML:
+		export_string (writer, "<datetime>");
+		export_datetime (writer, &dt);
+		export_string (writer, "</datetime>\n");
+		break;
+	case EXPORT_FORMAT_JSON:
+		export_string (writer, "{\"datetime\":\"");
+		export_datetime (writer, &dt);
+		export_string (writer, "\",\"samples\":[");
+		break;
+	case EXPORT_FORMAT_CSV:
+		// The datetime is repeated on every row.
+		export_flush (writer);
+		export_datetime (writer, &dt);
+		memcpy (exp.datetime, writer->data, writer->size);
+		exp.datetime[writer->size] = 0;
+		writer->size = 0;
+		break;
+	case EXPORT_FORMAT_BINARY:
+		export_record (writer, BINARY_DIVE, 7);
+		export_uint16_le (writer, dt.year);
+		unsigned char fields[5] = {dt.month, dt.day, dt.hour, dt.minute, dt.second};
+		export_write (writer, fields, sizeof (fields));
+		break;
+	}
+
+	// Write the samples.
+	rc = parser_samples_foreach (parser, export_sample, &exp);
+
+	// Write the dive trailer.
+	if (rc == PARSER_STATUS_SUCCESS) {
+		switch (format) {
+		case EXPORT_FORMAT_XML:
+			if (exp.nsamples)
+				export_string (writer, "</sample>\n");
+			break;
+		case EXPORT_FORMAT_JSON:
+			export_string (writer, "]}\n");
+			break;
+		default:
+			break;
+		}
+	}
+
+	export_flush (writer);
+
+	if (writer->error) {
+		WARNING ("Insufficient buffer space available.");
+		rc = PARSER_STATUS_MEMORY;
+	}
+
+	// Discard the partial dive on failure.
+	if (rc != PARSER_STATUS_SUCCESS)
+		dc_buffer_resize (buffer, offset);
+
+	return rc;
+}
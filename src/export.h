@@ -0,0 +1,48 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2009 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_EXPORT_H
+#define DC_EXPORT_H
+
+#include "buffer.h"
+#include "parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef enum export_format_t {
+	EXPORT_FORMAT_XML,
+	EXPORT_FORMAT_JSON,
+	EXPORT_FORMAT_CSV,
+	EXPORT_FORMAT_BINARY
+} export_format_t;
+
+parser_status_t
+export_header (export_format_t format, dc_buffer_t *buffer);
+
+parser_status_t
+export_dive (parser_t *parser, export_format_t format, dc_buffer_t *buffer);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_EXPORT_H */
@@ -53,6 +53,8 @@ static const device_backend_t hw_ostc_device_backend = {
 	NULL, /* read */
 	NULL, /* write */
 	hw_ostc_device_dump, /* dump */
+	NULL, /* dump_to */
+	NULL, /* dump_delta */
 	hw_ostc_device_foreach, /* foreach */
 	hw_ostc_device_close /* close */
 };
@@ -96,6 +98,9 @@ hw_ostc_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
+	// Record the traffic in the trace buffer.
+	serial_set_trace (device->port, device_get_trace ((device_t *) device));
+
 	// Set the serial communication protocol (115200 8N1).
 	rc = serial_configure (device->port, 115200, 8, SERIAL_PARITY_NONE, 1, SERIAL_FLOWCONTROL_NONE);
 	if (rc == -1) {
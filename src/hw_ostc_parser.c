@@ -20,6 +20,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "hw_ostc.h"
@@ -27,19 +28,37 @@
 #include "array.h"
 #include "utils.h"
 
-#define NINFO 6
+#define NINFO   6
+#define MAXPLAN 840
 
-typedef struct hw_ostc_parser_t hw_ostc_parser_t;
+#define INFO_TEMPERATURE 0
+#define INFO_PRESSURE    2
 
-struct hw_ostc_parser_t {
-	parser_t base;
-};
+typedef struct hw_ostc_parser_t hw_ostc_parser_t;
 
 typedef struct hw_ostc_sample_info_t {
 	unsigned int divisor;
 	unsigned int size;
 } hw_ostc_sample_info_t;
 
+// The extended sample info is stored with a fixed schedule. Each entry
+// contains the decoded fields and the total size for one position in
+// this schedule, so the samples can be parsed without having to
+// evaluate all the divisors again for each sample.
+typedef struct hw_ostc_sample_plan_t {
+	unsigned char size;
+	unsigned char count;
+	unsigned char info[NINFO];
+	unsigned char offset[NINFO];
+} hw_ostc_sample_plan_t;
+
+struct hw_ostc_parser_t {
+	parser_t base;
+	hw_ostc_sample_info_t info[NINFO];
+	unsigned int nplan;
+	hw_ostc_sample_plan_t plan[MAXPLAN];
+};
+
 static parser_status_t hw_ostc_parser_set_data (parser_t *abstract, const unsigned char *data, unsigned int size);
 static parser_status_t hw_ostc_parser_get_datetime (parser_t *abstract, dc_datetime_t *datetime);
 static parser_status_t hw_ostc_parser_samples_foreach (parser_t *abstract, sample_callback_t callback, void *userdata);
@@ -80,6 +99,10 @@ hw_ostc_parser_create (parser_t **out)
 	// Initialize the base class.
 	parser_init (&parser->base, &hw_ostc_parser_backend);
 
+	// Set the default values.
+	memset (parser->info, 0, sizeof (parser->info));
+	parser->nplan = 0;
+
 	*out = (parser_t*) parser;
 
 	return PARSER_STATUS_SUCCESS;
@@ -99,12 +122,77 @@ hw_ostc_parser_destroy (parser_t *abstract)
 }
 
 
+static unsigned int
+gcd (unsigned int a, unsigned int b)
+{
+	while (b) {
+		unsigned int t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+
+static void
+hw_ostc_parser_plan_entry (const hw_ostc_sample_info_t info[], unsigned int nsamples, hw_ostc_sample_plan_t *entry)
+{
+	entry->size = 0;
+	entry->count = 0;
+
+	for (unsigned int i = 0; i < NINFO; ++i) {
+		if (info[i].divisor && (nsamples % info[i].divisor) == 0) {
+			// Only the temperature and tank pressure are decoded.
+			if ((i == INFO_TEMPERATURE || i == INFO_PRESSURE) && info[i].size == 2) {
+				entry->info[entry->count] = i;
+				entry->offset[entry->count] = entry->size;
+				entry->count++;
+			}
+
+			entry->size += info[i].size;
+		}
+	}
+}
+
+
 static parser_status_t
 hw_ostc_parser_set_data (parser_t *abstract, const unsigned char *data, unsigned int size)
 {
+	hw_ostc_parser_t *parser = (hw_ostc_parser_t *) abstract;
+
 	if (! parser_is_hw_ostc (abstract))
 		return PARSER_STATUS_TYPE_MISMATCH;
 
+	// Reset the sample schedule.
+	memset (parser->info, 0, sizeof (parser->info));
+	parser->nplan = 0;
+
+	// Check the profile version
+	if (size < 47 || data[2] != 0x20)
+		return PARSER_STATUS_SUCCESS;
+
+	// Get the extended sample configuration.
+	unsigned int period = 1;
+	for (unsigned int i = 0; i < NINFO; ++i) {
+		parser->info[i].divisor = (data[37 + i] & 0x0F);
+		parser->info[i].size    = (data[37 + i] & 0xF0) >> 4;
+
+		// The schedule repeats itself after the least
+		// common multiple of all divisors.
+		if (parser->info[i].divisor && period <= MAXPLAN)
+			period = period / gcd (period, parser->info[i].divisor) * parser->info[i].divisor;
+	}
+
+	// Precompute the schedule, unless it is too long. In that
+	// case, the entries are calculated for each sample.
+	if (period <= MAXPLAN) {
+		for (unsigned int i = 0; i < period; ++i) {
+			hw_ostc_parser_plan_entry (parser->info, i, parser->plan + i);
+		}
+		parser->nplan = period;
+	}
+
 	return PARSER_STATUS_SUCCESS;
 }
 
@@ -133,6 +221,8 @@ hw_ostc_parser_get_datetime (parser_t *abstract, dc_datetime_t *datetime)
 static parser_status_t
 hw_ostc_parser_samples_foreach (parser_t *abstract, sample_callback_t callback, void *userdata)
 {
+	hw_ostc_parser_t *parser = (hw_ostc_parser_t *) abstract;
+
 	if (! parser_is_hw_ostc (abstract))
 		return PARSER_STATUS_TYPE_MISMATCH;
 
@@ -146,15 +236,9 @@ hw_ostc_parser_samples_foreach (parser_t *abstract, sample_callback_t callback,
 	// Get the sample rate.
 	unsigned int samplerate = data[36];
 
-	// Get the extended sample configuration.
-	hw_ostc_sample_info_t info[NINFO];
-	for (unsigned int i = 0; i < NINFO; ++i) {
-		info[i].divisor = (data[37 + i] & 0x0F);
-		info[i].size    = (data[37 + i] & 0xF0) >> 4;
-	}
-
 	unsigned int time = 0;
 	unsigned int nsamples = 0;
+	unsigned int position = 0;
 
 	unsigned int offset = 47;
 	while (offset + 3 <= size) {
@@ -211,35 +295,40 @@ hw_ostc_parser_samples_foreach (parser_t *abstract, sample_callback_t callback,
 			}
 		}
 
+		// Get the schedule entry for the current sample.
+		hw_ostc_sample_plan_t entry;
+		const hw_ostc_sample_plan_t *plan = &entry;
+		if (parser->nplan) {
+			if (++position == parser->nplan)
+				position = 0;
+			plan = parser->plan + position;
+		} else {
+			hw_ostc_parser_plan_entry (parser->info, nsamples, &entry);
+		}
+
+		// Check for buffer overflows.
+		if (offset + plan->size > size)
+			return PARSER_STATUS_ERROR;
+
 		// Extended sample info.
-		for (unsigned int i = 0; i < NINFO; ++i) {
-			if (info[i].divisor && (nsamples % info[i].divisor) == 0) {
-				unsigned int value = 0;
-				switch (i) {
-				case 0: // Temperature (0.1 °C).
-					assert (info[i].size == 2);
-					value = array_uint16_le (data + offset);
-					sample.temperature = value / 10.0;
-					if (callback) callback (SAMPLE_TYPE_TEMPERATURE, sample, userdata);
-					break;
-				case 1: // Deco/NDL Status
-					break;
-				case 2: // Tank pressure
-					assert (info[i].size == 2);
-					value = array_uint16_le (data + offset);
-					sample.pressure.tank = 0;
-					sample.pressure.value = value;
-					if (callback) callback (SAMPLE_TYPE_PRESSURE, sample, userdata);
-					break;
-				case 3: // ppO2 Sensor Values
-					break;
-				default: // Not yet used.
-					break;
-				}
-
-				offset += info[i].size;
+		for (unsigned int i = 0; i < plan->count; ++i) {
+			unsigned int value = array_uint16_le (data + offset + plan->offset[i]);
+			switch (plan->info[i]) {
+			case INFO_TEMPERATURE: // Temperature (0.1 °C).
+				sample.temperature = value / 10.0;
+				if (callback) callback (SAMPLE_TYPE_TEMPERATURE, sample, userdata);
+				break;
+			case INFO_PRESSURE: // Tank pressure
+				sample.pressure.tank = 0;
+				sample.pressure.value = value;
+				if (callback) callback (SAMPLE_TYPE_PRESSURE, sample, userdata);
+				break;
+			default:
+				break;
 			}
 		}
+
+		offset += plan->size;
 	}
 
 	assert (data[offset] == 0xFD && data[offset + 1] == 0xFD);
@@ -40,6 +40,7 @@
 #include "irda.h"
 #include "utils.h"
 #include "array.h"
+#include "trace.h"
 
 #ifdef _WIN32
 #define TRACE(expr) \
@@ -70,6 +71,7 @@ struct irda {
 	int fd;
 #endif
 	long timeout;
+	struct trace_t *trace;
 };
 
 
@@ -166,6 +168,7 @@ irda_socket_open (irda **out)
 
 	// Default to blocking reads.
 	device->timeout = -1;
+	device->trace = NULL;
 
 	// Open the socket.
 	device->fd = socket (AF_IRDA, SOCK_STREAM, 0);
@@ -225,6 +228,18 @@ irda_socket_set_timeout (irda *device, long timeout)
 }
 
 
+int
+irda_socket_set_trace (irda *device, struct trace_t *trace)
+{
+	if (device == NULL)
+		return -1; // EINVAL (Invalid argument)
+
+	device->trace = trace;
+
+	return 0;
+}
+
+
 #define DISCOVER_MAX_DEVICES 16	// Maximum number of devices.
 #define DISCOVER_MAX_RETRIES 4	// Maximum number of retries.
 
@@ -443,6 +458,8 @@ irda_socket_read (irda* device, void* data, unsigned int size)
 		nbytes += n;
 	}
 
+	trace_append (device->trace, TRACE_DIRECTION_READ, data, nbytes);
+
 	return nbytes;
 }
 
@@ -464,5 +481,7 @@ irda_socket_write (irda* device, const void *data, unsigned int size)
 		nbytes += n;
 	}
 
+	trace_append (device->trace, TRACE_DIRECTION_WRITE, data, nbytes);
+
 	return nbytes;
 }
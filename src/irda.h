@@ -28,6 +28,8 @@ extern "C" {
 
 typedef struct irda irda;
 
+struct trace_t;
+
 typedef void (*irda_callback_t) (unsigned int address, const char *name, unsigned int charset, unsigned int hints, void *userdata);
 
 int irda_errcode (void);
@@ -44,6 +46,8 @@ int irda_socket_close (irda *device);
 
 int irda_socket_set_timeout (irda *device, long timeout);
 
+int irda_socket_set_trace (irda *device, struct trace_t *trace);
+
 int irda_socket_discover (irda *device, irda_callback_t callback, void *userdata);
 
 int irda_socket_connect_name (irda *device, unsigned int address, const char *name);
@@ -72,6 +72,13 @@ irda_socket_set_timeout (irda *device, long timeout)
 }
 
 
+int
+irda_socket_set_trace (irda *device, struct trace_t *trace)
+{
+	return -1;
+}
+
+
 int
 irda_socket_discover (irda *device, irda_callback_t callback, void *userdata)
 {
@@ -51,6 +51,9 @@ mares_common_device_set_fingerprint (device_t *device, const unsigned char data[
 device_status_t
 mares_common_extract_dives (mares_common_device_t *device, const mares_common_layout_t *layout, const unsigned char data[], dive_callback_t callback, void *userdata);
 
+device_status_t
+mares_puck_device_open_timeout (device_t **device, const char* name, unsigned int timeout);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -54,6 +54,8 @@ static const device_backend_t mares_nemo_device_backend = {
 	NULL, /* read */
 	NULL, /* write */
 	mares_nemo_device_dump, /* dump */
+	NULL, /* dump_to */
+	NULL, /* dump_delta */
 	mares_nemo_device_foreach, /* foreach */
 	mares_nemo_device_close /* close */
 };
@@ -106,6 +108,9 @@ mares_nemo_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
+	// Record the traffic in the trace buffer.
+	serial_set_trace (device->port, device_get_trace ((device_t *) device));
+
 	// Set the serial communication protocol (9600 8N1).
 	rc = serial_configure (device->port, 9600, 8, SERIAL_PARITY_NONE, 1, SERIAL_FLOWCONTROL_NONE);
 	if (rc == -1) {
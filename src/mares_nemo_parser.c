@@ -213,17 +213,17 @@ mares_nemo_parser_samples_foreach (parser_t *abstract, sample_callback_t callbac
 	const unsigned char *data = abstract->data;
 	unsigned int size = abstract->size;
 
+	unsigned int nsamples = parser->sample_count;
+	unsigned int sample_size = parser->sample_size;
+
 	if (parser->mode != parser->freedive) {
 		unsigned int time = 0;
-		for (unsigned int i = 0; i < parser->sample_count; ++i) {
+		const unsigned char *p = data + 2;
+		for (unsigned int i = 0; i < nsamples; ++i, p += sample_size) {
 			parser_sample_value_t sample = {0};
 
-			unsigned int idx = 2 + parser->sample_size * i;
-			unsigned int value = array_uint16_le (data + idx);
+			unsigned int value = array_uint16_le (p);
 			unsigned int depth = value & 0x0FFF;
-			unsigned int ascent = (value & 0xC000) >> 14;
-			unsigned int violation = (value & 0x2000) >> 13;
-			unsigned int deco = (value & 0x1000) >> 12;
 
 			// Time (seconds).
 			time += 20;
@@ -234,6 +234,14 @@ mares_nemo_parser_samples_foreach (parser_t *abstract, sample_callback_t callbac
 			sample.depth = depth / 10.0;
 			if (callback) callback (SAMPLE_TYPE_DEPTH, sample, userdata);
 
+			// Most samples have no flags set at all.
+			if ((value & 0xF000) == 0)
+				continue;
+
+			unsigned int ascent = (value & 0xC000) >> 14;
+			unsigned int violation = (value & 0x2000) >> 13;
+			unsigned int deco = (value & 0x1000) >> 12;
+
 			// Ascent rate
 			if (ascent) {
 				sample.event.type = SAMPLE_EVENT_ASCENT;
@@ -271,10 +279,10 @@ mares_nemo_parser_samples_foreach (parser_t *abstract, sample_callback_t callbac
 
 		unsigned int time = 0;
 		unsigned int offset = parser->length;
-		for (unsigned int i = 0; i < parser->sample_count; ++i) {
+		for (unsigned int i = 0; i < nsamples; ++i) {
 			parser_sample_value_t sample = {0};
 
-			unsigned int idx = 2 + parser->sample_size * i;
+			unsigned int idx = 2 + sample_size * i;
 			unsigned int maxdepth = array_uint16_le (data + idx);
 			unsigned int divetime = data[idx + 2] + data[idx + 3] * 60;
 			unsigned int surftime = data[idx + 4] + data[idx + 5] * 60;
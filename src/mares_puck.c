@@ -36,18 +36,22 @@
 	rc == -1 ? DEVICE_STATUS_IO : DEVICE_STATUS_TIMEOUT \
 )
 
-#define PACKETSIZE 0x20
+#define PACKETSIZE    0x20
+#define MAXPACKETSIZE 0x80
 #define MAXRETRIES 4
 
 typedef struct mares_puck_device_t {
 	mares_common_device_t base;
 	struct serial *port;
+	unsigned int packetsize;
+	int probing;
 } mares_puck_device_t;
 
 static device_status_t mares_puck_device_read (device_t *abstract, unsigned int address, unsigned char data[], unsigned int size);
 static device_status_t mares_puck_device_dump (device_t *abstract, dc_buffer_t *buffer);
 static device_status_t mares_puck_device_foreach (device_t *abstract, dive_callback_t callback, void *userdata);
 static device_status_t mares_puck_device_close (device_t *abstract);
+static device_status_t mares_puck_device_probe (device_t *abstract, unsigned int packetsize, int *accepted);
 
 static const device_backend_t mares_puck_device_backend = {
 	DEVICE_TYPE_MARES_PUCK,
@@ -56,6 +60,8 @@ static const device_backend_t mares_puck_device_backend = {
 	mares_puck_device_read, /* read */
 	NULL, /* write */
 	mares_puck_device_dump, /* dump */
+	NULL, /* dump_to */
+	NULL, /* dump_delta */
 	mares_puck_device_foreach, /* foreach */
 	mares_puck_device_close /* close */
 };
@@ -96,6 +102,13 @@ device_is_mares_puck (device_t *abstract)
 
 device_status_t
 mares_puck_device_open (device_t **out, const char* name)
+{
+	return mares_puck_device_open_timeout (out, name, 0);
+}
+
+
+device_status_t
+mares_puck_device_open_timeout (device_t **out, const char* name, unsigned int timeout)
 {
 	if (out == NULL)
 		return DEVICE_STATUS_ERROR;
@@ -112,6 +125,8 @@ mares_puck_device_open (device_t **out, const char* name)
 
 	// Set the default values.
 	device->port = NULL;
+	device->packetsize = PACKETSIZE;
+	device->probing = 0;
 
 	// Open the device.
 	int rc = serial_open (&device->port, name);
@@ -121,6 +136,9 @@ mares_puck_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
+	// Record the traffic in the trace buffer.
+	serial_set_trace (device->port, device_get_trace ((device_t *) device));
+
 	// Set the serial communication protocol (38400 8N1).
 	rc = serial_configure (device->port, 38400, 8, SERIAL_PARITY_NONE, 1, SERIAL_FLOWCONTROL_NONE);
 	if (rc == -1) {
@@ -130,8 +148,9 @@ mares_puck_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
-	// Set the timeout for receiving data (1000 ms).
-	if (serial_set_timeout (device->port, 1000) == -1) {
+	// Set the timeout for receiving data (1000 ms), or the
+	// shorter timeout that was requested to identify the device.
+	if (serial_set_timeout (device->port, timeout ? timeout : 1000) == -1) {
 		WARNING ("Failed to set the timeout.");
 		serial_close (device->port);
 		free (device);
@@ -156,6 +175,14 @@ mares_puck_device_open (device_t **out, const char* name)
 		return status;
 	}
 
+	// Restore the normal timeout, now that the device is identified.
+	if (timeout && serial_set_timeout (device->port, 1000) == -1) {
+		WARNING ("Failed to set the timeout.");
+		serial_close (device->port);
+		free (device);
+		return DEVICE_STATUS_IO;
+	}
+
 	// Override the base class values.
 	switch (header[1]) {
 	case 1: // Nemo Wide
@@ -172,6 +199,18 @@ mares_puck_device_open (device_t **out, const char* name)
 		break;
 	}
 
+	// Set the memory size for the cache.
+	device_set_memory ((device_t *) device, device->base.layout->memsize, PACKETSIZE);
+	device_allow_checkpoint ((device_t *) device);
+
+	// Probe for the largest supported packet size.
+	status = device_probe_size ((device_t *) device, PACKETSIZE, MAXPACKETSIZE, mares_puck_device_probe);
+	if (status != DEVICE_STATUS_SUCCESS) {
+		serial_close (device->port);
+		free (device);
+		return status;
+	}
+
 	*out = (device_t*) device;
 
 	return DEVICE_STATUS_SUCCESS;
@@ -199,54 +238,6 @@ mares_puck_device_close (device_t *abstract)
 }
 
 
-static void
-mares_puck_convert_binary_to_ascii (const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize)
-{
-	assert (osize == 2 * isize);
-
-	const unsigned char ascii[] = {
-		'0', '1', '2', '3', '4', '5', '6', '7',
-		'8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
-
-	for (unsigned int i = 0; i < isize; ++i) {
-		// Set the most-significant nibble.
-		unsigned char msn = (input[i] >> 4) & 0x0F;
-		output[i * 2 + 0] = ascii[msn];
-
-		// Set the least-significant nibble.
-		unsigned char lsn = input[i] & 0x0F;
-		output[i * 2 + 1] = ascii[lsn];
-	}
-}
-
-
-static void
-mares_puck_convert_ascii_to_binary (const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize)
-{
-	assert (isize == 2 * osize);
-
-	for (unsigned int i = 0; i < osize; ++i) {
-		unsigned char value = 0;
-		for (unsigned int j = 0; j < 2; ++j) {
-			unsigned char number = 0;
-			unsigned char ascii = input[i * 2 + j];
-			if (ascii >= '0' && ascii <= '9')
-				number = ascii - '0';
-			else if (ascii >= 'A' && ascii <= 'F')
-				number = 10 + ascii - 'A';
-			else if (ascii >= 'a' && ascii <= 'f')
-				number = 10 + ascii - 'a';
-			else
-				WARNING ("Invalid charachter.");
-
-			value <<= 4;
-			value += number;
-		}
-		output[i] = value;
-	}
-}
-
-
 static void
 mares_puck_make_ascii (const unsigned char raw[], unsigned int rsize, unsigned char ascii[], unsigned int asize)
 {
@@ -256,11 +247,11 @@ mares_puck_make_ascii (const unsigned char raw[], unsigned int rsize, unsigned c
 	ascii[0] = '<';
 
 	// Data
-	mares_puck_convert_binary_to_ascii (raw, rsize, ascii + 1, 2 * rsize);
+	array_convert_bin2hex (raw, rsize, ascii + 1, 2 * rsize);
 
 	// Checksum
 	unsigned char checksum = checksum_add_uint8 (ascii + 1, 2 * rsize, 0x00);
-	mares_puck_convert_binary_to_ascii (&checksum, 1, ascii + 1 + 2 * rsize, 2);
+	array_convert_bin2hex (&checksum, 1, ascii + 1 + 2 * rsize, 2);
 
 	// Trailer
 	ascii[asize - 1] = '>';
@@ -295,10 +286,18 @@ mares_puck_packet (mares_puck_device_t *device, const unsigned char command[], u
 		return DEVICE_STATUS_PROTOCOL;
 	}
 
-	// Verify the checksum of the packet.
-	unsigned char crc = 0;
+	// Calculate the checksum of the packet.
 	unsigned char ccrc = checksum_add_uint8 (answer + 1, asize - 4, 0x00);
-	mares_puck_convert_ascii_to_binary (answer + asize - 3, 2, &crc, 1);
+
+	// Convert the payload and checksum to binary (in place).
+	unsigned int offset = array_convert_hex2bin (answer + 1, asize - 2, answer + 1, (asize - 2) / 2);
+	if (offset != asize - 2) {
+		WARNING ("Unexpected answer character.");
+		return DEVICE_STATUS_PROTOCOL;
+	}
+
+	// Verify the checksum of the packet.
+	unsigned char crc = answer[1 + (asize - 4) / 2];
 	if (crc != ccrc) {
 		WARNING ("Unexpected answer CRC.");
 		return DEVICE_STATUS_PROTOCOL;
@@ -337,14 +336,15 @@ mares_puck_device_read (device_t *abstract, unsigned int address, unsigned char
 		return DEVICE_STATUS_TYPE_MISMATCH;
 
 	// The data transmission is split in packages
-	// of maximum $PACKETSIZE bytes.
+	// of maximum $packetsize bytes.
 
+	int retried = 0;
 	unsigned int nbytes = 0;
 	while (nbytes < size) {
 		// Calculate the packet size.
 		unsigned int len = size - nbytes;
-		if (len > PACKETSIZE)
-			len = PACKETSIZE;
+		if (len > device->packetsize)
+			len = device->packetsize;
 
 		// Build the raw command.
 		unsigned char raw[] = {0x51,
@@ -356,14 +356,38 @@ mares_puck_device_read (device_t *abstract, unsigned int address, unsigned char
 		unsigned char command[2 * (sizeof (raw) + 2)] = {0};
 		mares_puck_make_ascii (raw, sizeof (raw), command, sizeof (command));
 
-		// Send the command and receive the answer.
-		unsigned char answer[2 * (PACKETSIZE + 2)] = {0};
-		device_status_t rc = mares_puck_transfer (device, command, sizeof (command), answer, 2 * (len + 2));
+		// Send the command and receive the answer. Packets larger
+		// than the default size are retried only once, because a
+		// single failure can be a transient error. After the second
+		// failure, or the first one while probing the packet size,
+		// the packet size is reduced to the default size, and the
+		// request is repeated with the default size. The input buffer
+		// is flushed to discard the late bytes of the failed answer.
+		unsigned char answer[2 * (MAXPACKETSIZE + 2)] = {0};
+		device_status_t rc = DEVICE_STATUS_SUCCESS;
+		if (len > PACKETSIZE) {
+			rc = mares_puck_packet (device, command, sizeof (command), answer, 2 * (len + 2));
+			if (rc == DEVICE_STATUS_PROTOCOL || rc == DEVICE_STATUS_TIMEOUT) {
+				serial_flush (device->port, SERIAL_QUEUE_INPUT);
+				if (!retried && !device->probing) {
+					retried = 1;
+					continue;
+				}
+				WARNING ("Packet size not supported, falling back to the default size.");
+				device->packetsize = PACKETSIZE;
+				retried = 0;
+				continue;
+			}
+		} else {
+			rc = mares_puck_transfer (device, command, sizeof (command), answer, 2 * (len + 2));
+		}
 		if (rc != DEVICE_STATUS_SUCCESS)
 			return rc;
 
+		retried = 0;
+
 		// Extract the raw data from the packet.
-		mares_puck_convert_ascii_to_binary (answer + 1, 2 * len, data, len);
+		memcpy (data, answer + 1, len);
 
 		nbytes += len;
 		address += len;
@@ -374,6 +398,30 @@ mares_puck_device_read (device_t *abstract, unsigned int address, unsigned char
 }
 
 
+static device_status_t
+mares_puck_device_probe (device_t *abstract, unsigned int packetsize, int *accepted)
+{
+	mares_puck_device_t *device = (mares_puck_device_t *) abstract;
+
+	// A packet size the Puck cannot handle ends in a protocol error or
+	// a timeout, after which the read function resets the packet size
+	// to the default size, without the usual retry.
+	unsigned char data[MAXPACKETSIZE] = {0};
+	device->packetsize = packetsize;
+	device->probing = 1;
+	device_status_t rc = mares_puck_device_read (abstract, 0, data, packetsize);
+	device->probing = 0;
+	if (rc != DEVICE_STATUS_SUCCESS) {
+		device->packetsize = PACKETSIZE;
+		return rc;
+	}
+
+	*accepted = (device->packetsize == packetsize);
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
 static device_status_t
 mares_puck_device_dump (device_t *abstract, dc_buffer_t *buffer)
 {
@@ -389,8 +437,15 @@ mares_puck_device_dump (device_t *abstract, dc_buffer_t *buffer)
 		return DEVICE_STATUS_MEMORY;
 	}
 
+	// Pages restored from a checkpoint are only valid as long
+	// as the memory header remains unchanged.
+	device_range_t areas[1] = {{0, device->layout->rb_profile_begin}};
+	device_status_t rc = device_checkpoint_verify (abstract, areas, 1);
+	if (rc != DEVICE_STATUS_SUCCESS)
+		return rc;
+
 	return device_dump_read (abstract, dc_buffer_get_data (buffer),
-		dc_buffer_get_size (buffer), PACKETSIZE);
+		dc_buffer_get_size (buffer), MAXPACKETSIZE);
 }
 
 
@@ -59,6 +59,8 @@ static const device_backend_t oceanic_atom2_device_backend = {
 	oceanic_atom2_device_read, /* read */
 	oceanic_atom2_device_write, /* write */
 	oceanic_common_device_dump, /* dump */
+	NULL, /* dump_to */
+	oceanic_common_device_dump_delta, /* dump_delta */
 	oceanic_common_device_foreach, /* foreach */
 	oceanic_atom2_device_close /* close */
 };
@@ -127,6 +129,8 @@ oceanic_atom2_send (oceanic_atom2_device_t *device, const unsigned char command[
 	// Verify the response of the dive computer.
 	if (response != ACK) {
 		WARNING ("Unexpected answer start byte(s).");
+		if (response == NAK)
+			device_stats_nak ((device_t *) device);
 		return DEVICE_STATUS_PROTOCOL;
 	}
 
@@ -143,15 +147,22 @@ oceanic_atom2_transfer (oceanic_atom2_device_t *device, const unsigned char comm
 	// a NAK byte, we try to resend the command a number of times before
 	// returning an error.
 
+	device_t *abstract = (device_t *) device;
+
 	unsigned int nretries = 0;
+	unsigned int timestamp = device_stats_begin (abstract);
 	device_status_t rc = DEVICE_STATUS_SUCCESS;
 	while ((rc = oceanic_atom2_send (device, command, csize)) != DEVICE_STATUS_SUCCESS) {
+		device_stats_error (abstract, rc);
+
 		if (rc != DEVICE_STATUS_TIMEOUT && rc != DEVICE_STATUS_PROTOCOL)
 			return rc;
 
 		// Abort if the maximum number of retries is reached.
 		if (nretries++ >= MAXRETRIES)
 			return rc;
+
+		timestamp = device_stats_retry (abstract);
 	}
 
 	if (asize) {
@@ -159,6 +170,7 @@ oceanic_atom2_transfer (oceanic_atom2_device_t *device, const unsigned char comm
 		int n = serial_read (device->port, answer, asize);
 		if (n != asize) {
 			WARNING ("Failed to receive the answer.");
+			device_stats_error (abstract, EXITCODE (n));
 			return EXITCODE (n);
 		}
 
@@ -167,10 +179,14 @@ oceanic_atom2_transfer (oceanic_atom2_device_t *device, const unsigned char comm
 		unsigned char ccrc = checksum_add_uint8 (answer, asize - 1, 0x00);
 		if (crc != ccrc) {
 			WARNING ("Unexpected answer CRC.");
+			device_stats_error (abstract, DEVICE_STATUS_PROTOCOL);
+			device_stats_crc (abstract);
 			return DEVICE_STATUS_PROTOCOL;
 		}
 	}
 
+	device_stats_end (abstract, timestamp);
+
 	return DEVICE_STATUS_SUCCESS;
 }
 
@@ -233,8 +249,51 @@ oceanic_atom2_quit (oceanic_atom2_device_t *device)
 }
 
 
+static device_status_t
+oceanic_atom2_handshake (oceanic_atom2_device_t *device)
+{
+	// Make sure everything is in a sane state.
+	serial_flush (device->port, SERIAL_QUEUE_BOTH);
+
+	// Send the init command.
+	device_status_t status = oceanic_atom2_init (device);
+	if (status != DEVICE_STATUS_SUCCESS)
+		return status;
+
+	// Make sure everything is in a sane state.
+	serial_flush (device->port, SERIAL_QUEUE_BOTH);
+
+	// Switch the device from surface mode into download mode. Before sending
+	// this command, the device needs to be in PC mode (automatically activated
+	// by connecting the device), or already in download mode.
+	status = oceanic_atom2_device_version ((device_t *) device, device->version, sizeof (device->version));
+	if (status != DEVICE_STATUS_SUCCESS)
+		return status;
+
+	// Override the base class values.
+	if (oceanic_common_match (oceanic_oc1_version, device->version, sizeof (device->version)))
+		device->base.layout = &oceanic_oc1_layout;
+	else
+		device->base.layout = &oceanic_atom2_layout;
+
+	// Set the memory size for the cache. The contents of the
+	// cache are discarded, because the memory may have changed.
+	device_set_memory ((device_t *) device, device->base.layout->memsize, PAGESIZE);
+	device_allow_checkpoint ((device_t *) device);
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
 device_status_t
 oceanic_atom2_device_open (device_t **out, const char* name)
+{
+	return oceanic_atom2_device_open_timeout (out, name, 0);
+}
+
+
+device_status_t
+oceanic_atom2_device_open_timeout (device_t **out, const char* name, unsigned int timeout)
 {
 	if (out == NULL)
 		return DEVICE_STATUS_ERROR;
@@ -261,6 +320,9 @@ oceanic_atom2_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
+	// Record the traffic in the trace buffer.
+	serial_set_trace (device->port, device_get_trace ((device_t *) device));
+
 	// Set the serial communication protocol (38400 8N1).
 	rc = serial_configure (device->port, 38400, 8, SERIAL_PARITY_NONE, 1, SERIAL_FLOWCONTROL_NONE);
 	if (rc == -1) {
@@ -270,8 +332,9 @@ oceanic_atom2_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
-	// Set the timeout for receiving data (3000 ms).
-	if (serial_set_timeout (device->port, 3000) == -1) {
+	// Set the timeout for receiving data (3000 ms), or the
+	// shorter timeout that was requested to identify the device.
+	if (serial_set_timeout (device->port, timeout ? timeout : 3000) == -1) {
 		WARNING ("Failed to set the timeout.");
 		serial_close (device->port);
 		free (device);
@@ -281,42 +344,44 @@ oceanic_atom2_device_open (device_t **out, const char* name)
 	// Give the interface 100 ms to settle and draw power up.
 	serial_sleep (100);
 
-	// Make sure everything is in a sane state.
-	serial_flush (device->port, SERIAL_QUEUE_BOTH);
-
-	// Send the init command.
-	device_status_t status = oceanic_atom2_init (device);
+	// Identify the device.
+	device_status_t status = oceanic_atom2_handshake (device);
 	if (status != DEVICE_STATUS_SUCCESS) {
 		serial_close (device->port);
 		free (device);
 		return status;
 	}
 
-	// Make sure everything is in a sane state.
-	serial_flush (device->port, SERIAL_QUEUE_BOTH);
-
-	// Switch the device from surface mode into download mode. Before sending
-	// this command, the device needs to be in PC mode (automatically activated
-	// by connecting the device), or already in download mode.
-	status = oceanic_atom2_device_version ((device_t *) device, device->version, sizeof (device->version));
-	if (status != DEVICE_STATUS_SUCCESS) {
+	// Restore the normal timeout, now that the device is identified.
+	if (timeout && serial_set_timeout (device->port, 3000) == -1) {
+		WARNING ("Failed to set the timeout.");
 		serial_close (device->port);
 		free (device);
-		return status;
+		return DEVICE_STATUS_IO;
 	}
 
-	// Override the base class values.
-	if (oceanic_common_match (oceanic_oc1_version, device->version, sizeof (device->version)))
-		device->base.layout = &oceanic_oc1_layout;
-	else
-		device->base.layout = &oceanic_atom2_layout;
-
 	*out = (device_t*) device;
 
 	return DEVICE_STATUS_SUCCESS;
 }
 
 
+device_status_t
+oceanic_atom2_device_reconnect (device_t *abstract)
+{
+	oceanic_atom2_device_t *device = (oceanic_atom2_device_t*) abstract;
+
+	if (! device_is_oceanic_atom2 (abstract))
+		return DEVICE_STATUS_TYPE_MISMATCH;
+
+	// The serial port remains open and configured, so only the
+	// handshake needs to be repeated. This is sufficient to start
+	// a new session when the same device is still connected, or
+	// when another device has been connected to the same interface.
+	return oceanic_atom2_handshake (device);
+}
+
+
 static device_status_t
 oceanic_atom2_device_close (device_t *abstract)
 {
@@ -35,6 +35,9 @@ oceanic_atom2_device_open (device_t **device, const char* name);
 device_status_t
 oceanic_atom2_device_keepalive (device_t *device);
 
+device_status_t
+oceanic_atom2_device_reconnect (device_t *device);
+
 parser_status_t
 oceanic_atom2_parser_create (parser_t **parser, unsigned int model);
 
@@ -220,6 +220,11 @@ oceanic_atom2_parser_samples_foreach (parser_t *abstract, sample_callback_t call
 		break;
 	}
 
+	// The model specific variations of the sample format are
+	// resolved once, instead of for every sample.
+	int pressure1psi = (parser->model == 0x4347);
+	int absolute = (parser->model == 0x4344);
+
 	int complete = 1;
 
 	unsigned int tank = 0;
@@ -227,14 +232,17 @@ oceanic_atom2_parser_samples_foreach (parser_t *abstract, sample_callback_t call
 	unsigned int temperature = data[header + 7];
 
 	unsigned int offset = header + PAGESIZE / 2;
-	while (offset + PAGESIZE / 2 <= size - PAGESIZE) {
+	unsigned int end = size - PAGESIZE;
+	while (offset + PAGESIZE / 2 <= end) {
+		const unsigned char *p = data + offset;
 		parser_sample_value_t sample = {0};
 
-		// Ignore empty samples.
-		if (array_isequal (data + offset, PAGESIZE / 2, 0x00)) {
-			offset += PAGESIZE / 2;
+		offset += PAGESIZE / 2;
+
+		// Ignore empty samples. The samples have a fixed size of
+		// 8 bytes, which are combined without any branches.
+		if ((p[0] | p[1] | p[2] | p[3] | p[4] | p[5] | p[6] | p[7]) == 0)
 			continue;
-		}
 
 		// Time.
 		if (complete) {
@@ -244,52 +252,56 @@ oceanic_atom2_parser_samples_foreach (parser_t *abstract, sample_callback_t call
 		}
 
 		// Vendor specific data
-		sample.vendor.type = SAMPLE_VENDOR_OCEANIC_ATOM2;
-		sample.vendor.size = PAGESIZE / 2;
-		sample.vendor.data = data + offset;
-		if (callback) callback (SAMPLE_TYPE_VENDOR, sample, userdata);
+		if (SAMPLE_ENABLED (abstract, SAMPLE_TYPE_VENDOR)) {
+			sample.vendor.type = SAMPLE_VENDOR_OCEANIC_ATOM2;
+			sample.vendor.size = PAGESIZE / 2;
+			sample.vendor.data = p;
+			if (callback) callback (SAMPLE_TYPE_VENDOR, sample, userdata);
+		}
 
 		// Check for a tank switch sample.
-		if (data[offset + 0] == 0xAA) {
-			if (parser->model == 0x4347) {
+		if (p[0] == 0xAA) {
+			if (pressure1psi) {
 				// Tank pressure (1 psi) and number
 				tank = 0;
-				pressure = (((data[offset + 7] << 8) + data[offset + 6]) & 0x0FFF);
+				pressure = ((p[7] << 8) + p[6]) & 0x0FFF;
 			} else {
 				// Tank pressure (2 psi) and number (one based index)
-				tank = (data[offset + 1] & 0x03) - 1;
-				pressure = (((data[offset + 4] << 8) + data[offset + 5]) & 0x0FFF) * 2;
+				tank = (p[1] & 0x03) - 1;
+				pressure = (((p[4] << 8) + p[5]) & 0x0FFF) * 2;
 			}
 
 			complete = 0;
 		} else {
 			// Temperature (°F)
-			if (parser->model == 0x4344) {
-				temperature = data[offset + 6];
+			if (absolute) {
+				temperature = p[6];
 			} else {
-				if (data[offset + 0] & 0x80)
-					temperature += (data[offset + 7] & 0xFC) >> 2;
+				if (p[0] & 0x80)
+					temperature += p[7] >> 2;
 				else
-					temperature -= (data[offset + 7] & 0xFC) >> 2;
+					temperature -= p[7] >> 2;
+			}
+			if (SAMPLE_ENABLED (abstract, SAMPLE_TYPE_TEMPERATURE)) {
+				sample.temperature = (temperature - 32.0) * (5.0 / 9.0);
+				if (callback) callback (SAMPLE_TYPE_TEMPERATURE, sample, userdata);
 			}
-			sample.temperature = (temperature - 32.0) * (5.0 / 9.0);
-			if (callback) callback (SAMPLE_TYPE_TEMPERATURE, sample, userdata);
 
 			// Tank Pressure (psi)
-			pressure -= data[offset + 1];
-			sample.pressure.tank = tank;
-			sample.pressure.value = pressure * PSI / BAR;
-			if (callback && pressure != 10000) callback (SAMPLE_TYPE_PRESSURE, sample, userdata);
+			pressure -= p[1];
+			if (SAMPLE_ENABLED (abstract, SAMPLE_TYPE_PRESSURE)) {
+				sample.pressure.tank = tank;
+				sample.pressure.value = pressure * PSI / BAR;
+				if (callback && pressure != 10000) callback (SAMPLE_TYPE_PRESSURE, sample, userdata);
+			}
 
 			// Depth (1/16 ft)
-			unsigned int depth = (data[offset + 2] + (data[offset + 3] << 8)) & 0x0FFF;
-			sample.depth = depth / 16.0 * FEET;
+			unsigned int depth = (p[2] + (p[3] << 8)) & 0x0FFF;
+			sample.depth = depth * (FEET / 16.0);
 			if (callback) callback (SAMPLE_TYPE_DEPTH, sample, userdata);
 
 			complete = 1;
 		}
-
-		offset += PAGESIZE / 2;
 	}
 
 	return PARSER_STATUS_SUCCESS;
@@ -26,14 +26,17 @@
 #include "oceanic_common.h"
 #include "device-private.h"
 #include "ringbuffer.h"
+#include "rbstream.h"
 #include "array.h"
 #include "utils.h"
 
 #define RB_LOGBOOK_DISTANCE(a,b,l)	ringbuffer_distance (a, b, 0, l->rb_logbook_begin, l->rb_logbook_end)
 #define RB_LOGBOOK_INCR(a,b,l)		ringbuffer_increment (a, b, l->rb_logbook_begin, l->rb_logbook_end)
+#define RB_LOGBOOK_DECR(a,b,l)		ringbuffer_decrement (a, b, l->rb_logbook_begin, l->rb_logbook_end)
 
 #define RB_PROFILE_DISTANCE(a,b,l)	ringbuffer_distance (a, b, 0, l->rb_profile_begin, l->rb_profile_end)
 #define RB_PROFILE_INCR(a,b,l)		ringbuffer_increment (a, b, l->rb_profile_begin, l->rb_profile_end)
+#define RB_PROFILE_DECR(a,b,l)		ringbuffer_decrement (a, b, l->rb_profile_begin, l->rb_profile_end)
 
 
 static unsigned int
@@ -88,6 +91,87 @@ get_profile_last (const unsigned char data[], const oceanic_common_layout_t *lay
 }
 
 
+static int
+get_profile_end (const unsigned char data[], const oceanic_common_layout_t *layout, unsigned int *end)
+{
+	// Get the logbook pointers.
+	unsigned int rb_logbook_first = array_uint16_le (data + layout->cf_pointers + 4);
+	unsigned int rb_logbook_last  = array_uint16_le (data + layout->cf_pointers + 6);
+	if (rb_logbook_first < layout->rb_logbook_begin ||
+		rb_logbook_first >= layout->rb_logbook_end ||
+		rb_logbook_last < layout->rb_logbook_begin ||
+		rb_logbook_last >= layout->rb_logbook_end)
+		return 0;
+
+	// Locate the most recent logbook entry.
+	unsigned int current = rb_logbook_last;
+	if (layout->pt_mode_global != 0)
+		current = RB_LOGBOOK_DECR (rb_logbook_last, PAGESIZE / 2, layout);
+	if (array_isequal (data + current, PAGESIZE / 2, 0xFF))
+		return 0;
+
+	// Get the end of its profile data.
+	unsigned int rb_profile_last = get_profile_last (data + current, layout);
+	if (rb_profile_last < layout->rb_profile_begin ||
+		rb_profile_last >= layout->rb_profile_end)
+		return 0;
+
+	*end = RB_PROFILE_INCR (rb_profile_last, PAGESIZE, layout);
+
+	return 1;
+}
+
+
+static int
+check_profile_window (const unsigned char previous[], const unsigned char data[], const oceanic_common_layout_t *layout, unsigned int eop_old, unsigned int eop_new)
+{
+	unsigned int rb_logbook_first = array_uint16_le (data + layout->cf_pointers + 4);
+	unsigned int rb_logbook_last  = array_uint16_le (data + layout->cf_pointers + 6);
+
+	unsigned int window = RB_PROFILE_DISTANCE (eop_old, eop_new, layout);
+
+	// Walk the logbook backwards, from the most recent entry until the
+	// first entry that is unchanged since the previous image. The profile
+	// data of all new entries must fit between both end pointers, or more
+	// than one full ringbuffer has been written in the meantime.
+	unsigned int total = 0;
+	unsigned int current = rb_logbook_last;
+	if (layout->pt_mode_global != 0)
+		current = RB_LOGBOOK_DECR (rb_logbook_last, PAGESIZE / 2, layout);
+	unsigned int nentries = (layout->rb_logbook_end - layout->rb_logbook_begin) / (PAGESIZE / 2);
+	for (unsigned int i = 0; i < nentries; ++i) {
+		if (array_isequal (data + current, PAGESIZE / 2, 0xFF) ||
+			memcmp (previous + current, data + current, PAGESIZE / 2) == 0)
+			return 1;
+
+		unsigned int rb_entry_first = get_profile_first (data + current, layout);
+		unsigned int rb_entry_last  = get_profile_last (data + current, layout);
+		if (rb_entry_first < layout->rb_profile_begin ||
+			rb_entry_first >= layout->rb_profile_end ||
+			rb_entry_last < layout->rb_profile_begin ||
+			rb_entry_last >= layout->rb_profile_end)
+			return 0;
+
+		unsigned int rb_entry_end = RB_PROFILE_INCR (rb_entry_last, PAGESIZE, layout);
+		unsigned int rb_entry_size = RB_PROFILE_DISTANCE (rb_entry_first, rb_entry_end, layout);
+		if (RB_PROFILE_DISTANCE (eop_old, rb_entry_first, layout) + rb_entry_size > window)
+			return 0;
+
+		total += rb_entry_size;
+		if (total > window)
+			return 0;
+
+		if (current == rb_logbook_first)
+			return 1;
+
+		current = RB_LOGBOOK_DECR (current, PAGESIZE / 2, layout);
+	}
+
+	// The entire logbook has been replaced.
+	return 0;
+}
+
+
 int
 oceanic_common_match (const unsigned char *pattern, const unsigned char *string, unsigned int n)
 {
@@ -112,6 +196,51 @@ oceanic_common_device_init (oceanic_common_device_t *device, const device_backen
 	memset (device->fingerprint, 0, sizeof (device->fingerprint));
 	device->layout = NULL;
 	device->multipage = 1;
+	device->probing = 0;
+}
+
+
+static device_status_t
+oceanic_common_device_probe (device_t *abstract, unsigned int multipage, int *accepted)
+{
+	oceanic_common_device_t *device = (oceanic_common_device_t *) abstract;
+
+	// Memory buffer for the probe data.
+	unsigned char *data = (unsigned char *) malloc (PAGESIZE * multipage);
+	if (data == NULL) {
+		WARNING ("Failed to allocate memory.");
+		return DEVICE_STATUS_MEMORY;
+	}
+
+	// Read the first pages with a multipage request. The read functions
+	// of the Veo 250 and VT Pro drop back to their default multipage
+	// size when the request is rejected, without the usual retry.
+	device->multipage = multipage;
+	device->probing = 1;
+	device_status_t rc = device_read (abstract, 0, data, PAGESIZE * multipage);
+	device->probing = 0;
+
+	free (data);
+
+	*accepted = (device->multipage == multipage);
+
+	return rc;
+}
+
+
+device_status_t
+oceanic_common_device_probe_multipage (device_t *abstract, unsigned int maximum)
+{
+	oceanic_common_device_t *device = (oceanic_common_device_t *) abstract;
+
+	assert (device != NULL);
+
+	unsigned int defsize = device->multipage;
+	device_status_t rc = device_probe_size (abstract, defsize, maximum, oceanic_common_device_probe);
+	if (rc != DEVICE_STATUS_SUCCESS)
+		device->multipage = defsize;
+
+	return rc;
 }
 
 
@@ -149,11 +278,86 @@ oceanic_common_device_dump (device_t *abstract, dc_buffer_t *buffer)
 		return DEVICE_STATUS_MEMORY;
 	}
 
+	// Pages restored from a checkpoint are only valid as long as the
+	// configuration data (with the device id and the ringbuffer
+	// pointers) below the logbook ringbuffer remains unchanged.
+	device_range_t areas[1] = {{0, device->layout->rb_logbook_begin}};
+	device_status_t rc = device_checkpoint_verify (abstract, areas, 1);
+	if (rc != DEVICE_STATUS_SUCCESS)
+		return rc;
+
 	return device_dump_read (abstract, dc_buffer_get_data (buffer),
 		dc_buffer_get_size (buffer), PAGESIZE * device->multipage);
 }
 
 
+device_status_t
+oceanic_common_device_dump_delta (device_t *abstract, const unsigned char previous[], unsigned int size, dc_buffer_t *buffer)
+{
+	oceanic_common_device_t *device = (oceanic_common_device_t *) abstract;
+
+	assert (device != NULL);
+	assert (device->layout != NULL);
+
+	const oceanic_common_layout_t *layout = device->layout;
+
+	if (size != layout->memsize)
+		return oceanic_common_device_dump (abstract, buffer);
+
+	// Start from a copy of the previous memory image.
+	if (!dc_buffer_clear (buffer) || !dc_buffer_append (buffer, previous, size)) {
+		WARNING ("Insufficient buffer space available.");
+		return DEVICE_STATUS_MEMORY;
+	}
+
+	unsigned char *data = dc_buffer_get_data (buffer);
+
+	// Enable progress notifications.
+	device_progress_t progress = DEVICE_PROGRESS_INITIALIZER;
+	device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
+
+	// Pages restored from a checkpoint are only valid as long as the
+	// configuration data (with the device id and the ringbuffer
+	// pointers) below the logbook ringbuffer remains unchanged.
+	device_range_t areas[1] = {{0, layout->rb_logbook_begin}};
+	device_status_t rc = device_checkpoint_verify (abstract, areas, 1);
+	if (rc != DEVICE_STATUS_SUCCESS)
+		return rc;
+
+	// Read the configuration data and the logbook ringbuffer. Both are
+	// small compared to the profile ringbuffer, and always downloaded.
+	device_range_t ranges[2] = {{0, layout->rb_logbook_end}};
+	rc = device_dump_ranges (abstract, data, ranges, 1, PAGESIZE * device->multipage, &progress);
+	if (rc != DEVICE_STATUS_SUCCESS)
+		return rc;
+
+	// The entire profile ringbuffer is downloaded again for a different
+	// device, for invalid pointers, when the logbook has changed without
+	// the end of the profiles moving, or when the new dives do not fit
+	// between both end pointers. Otherwise only the area between both
+	// end pointers has changed, with a safety margin of one packet.
+	unsigned int eop_old = 0, eop_new = 0;
+	unsigned int n = 0;
+	if (memcmp (previous + layout->cf_devinfo, data + layout->cf_devinfo, PAGESIZE) != 0 ||
+		!get_profile_end (previous, layout, &eop_old) ||
+		!get_profile_end (data, layout, &eop_new) ||
+		(eop_old == eop_new && memcmp (previous + layout->rb_logbook_begin, data + layout->rb_logbook_begin,
+			layout->rb_logbook_end - layout->rb_logbook_begin) != 0) ||
+		!check_profile_window (previous, data, layout, eop_old, eop_new))
+	{
+		ranges[n].address = layout->rb_profile_begin;
+		ranges[n].size = layout->rb_profile_end - layout->rb_profile_begin;
+		n++;
+	} else {
+		unsigned int first = RB_PROFILE_DECR (eop_old, PAGESIZE * device->multipage, layout);
+		unsigned int end   = RB_PROFILE_INCR (eop_new, PAGESIZE, layout);
+		n += device_range_ringbuffer (ranges + n, first, end, layout->rb_profile_begin, layout->rb_profile_end);
+	}
+
+	return device_dump_ranges (abstract, data, ranges, n, PAGESIZE * device->multipage, &progress);
+}
+
+
 device_status_t
 oceanic_common_device_foreach (device_t *abstract, dive_callback_t callback, void *userdata)
 {
@@ -171,9 +375,19 @@ oceanic_common_device_foreach (device_t *abstract, dive_callback_t callback, voi
 		(layout->rb_logbook_end - layout->rb_logbook_begin);
 	device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
 
+	// Pages restored from a checkpoint are only valid as long as the
+	// configuration data (with the device id and the ringbuffer
+	// pointers) below the logbook ringbuffer remains unchanged.
+	device_range_t areas[1] = {{0, layout->rb_logbook_begin}};
+	device_status_t rc = device_checkpoint_verify (abstract, areas, 1);
+	if (rc != DEVICE_STATUS_SUCCESS) {
+		WARNING ("Cannot verify the checkpoint.");
+		return rc;
+	}
+
 	// Read the device id.
 	unsigned char id[PAGESIZE] = {0};
-	device_status_t rc = device_read (abstract, layout->cf_devinfo, id, sizeof (id));
+	rc = device_read (abstract, layout->cf_devinfo, id, sizeof (id));
 	if (rc != DEVICE_STATUS_SUCCESS) {
 		WARNING ("Cannot read device id.");
 		return rc;
@@ -400,11 +614,19 @@ oceanic_common_device_foreach (device_t *abstract, dive_callback_t callback, voi
 		return DEVICE_STATUS_MEMORY;
 	}
 
-	// When using multipage reads, the last packet can contain data from more
-	// than one dive. Therefore, the remaining data of this package (and its
-	// size) needs to be preserved for the next dive.
+	// Create the ringbuffer stream. When using multipage reads, the last
+	// packet can contain data from more than one dive. The stream keeps
+	// those bytes available for the next dive.
+	rbstream_t *rbstream = NULL;
+	rc = rbstream_new (&rbstream, abstract, PAGESIZE, PAGESIZE * device->multipage, 0,
+		layout->rb_profile_begin, layout->rb_profile_end, rb_profile_end, rb_profile_size);
+	if (rc != DEVICE_STATUS_SUCCESS) {
+		free (logbooks);
+		free (profiles);
+		return rc;
+	}
+
 	unsigned int remaining = rb_profile_size;
-	unsigned int available = 0;
 
 	// Keep track of the previous dive.
 	unsigned int previous = rb_profile_end;
@@ -415,7 +637,6 @@ oceanic_common_device_foreach (device_t *abstract, dive_callback_t callback, voi
 	// of the memory buffer.
 	current = end;
 	offset = rb_profile_size + (end - begin);
-	address = previous;
 	while (current != begin) {
 		// Move to the start of the current entry.
 		current -= PAGESIZE / 2;
@@ -429,6 +650,7 @@ oceanic_common_device_foreach (device_t *abstract, dive_callback_t callback, voi
 		// Make sure the profiles are continuous.
 		if (rb_entry_end != previous) {
 			WARNING ("Profiles are not continuous.");
+			rbstream_free (rbstream);
 			free (logbooks);
 			free (profiles);
 			return DEVICE_STATUS_ERROR;
@@ -437,64 +659,42 @@ oceanic_common_device_foreach (device_t *abstract, dive_callback_t callback, voi
 		// Make sure the profile size is valid.
 		if (rb_entry_size > remaining) {
 			WARNING ("Unexpected profile size.");
+			rbstream_free (rbstream);
 			free (logbooks);
 			free (profiles);
 			return DEVICE_STATUS_ERROR;
 		}
 
-		// Read the profile data.
-		unsigned int nbytes = available;
-		while (nbytes < rb_entry_size) {
-			// Handle the ringbuffer wrap point.
-			if (address == layout->rb_profile_begin)
-				address = layout->rb_profile_end;
-
-			// Calculate the optimal packet size.
-			unsigned int len = PAGESIZE * device->multipage;
-			if (layout->rb_profile_begin + len > address)
-				len = address - layout->rb_profile_begin; // End of ringbuffer.
-			if (nbytes + len > remaining)
-				len = remaining - nbytes; // End of profile.
-
-			// Move to the start of the current page.
-			address -= len;
-			offset -= len;
-
-			// Read the profile page.
-			rc = device_read (abstract, address, profiles + offset, len);
-			if (rc != DEVICE_STATUS_SUCCESS) {
-				free (logbooks);
-				free (profiles);
-				return rc;
-			}
-
-			// Update and emit a progress event.
-			progress.current += len;
-			device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
+		// Move to the start of the current profile.
+		offset -= rb_entry_size;
 
-			nbytes += len;
+		// Read the profile data.
+		rc = rbstream_read (rbstream, &progress, profiles + offset, rb_entry_size);
+		if (rc != DEVICE_STATUS_SUCCESS) {
+			rbstream_free (rbstream);
+			free (logbooks);
+			free (profiles);
+			return rc;
 		}
 
-		available = nbytes - rb_entry_size;
 		remaining -= rb_entry_size;
 		previous = rb_entry_first;
 
-		// Prepend the logbook entry to the profile data. The memory buffer is
-		// large enough to store this entry, but any data that belongs to the
-		// next dive needs to be moved down first.
-		if (available)
-			memmove (profiles + offset - PAGESIZE / 2, profiles + offset, available);
+		// Prepend the logbook entry to the profile data. The memory buffer
+		// is large enough to store this entry.
 		offset -= PAGESIZE / 2;
-		memcpy (profiles + offset + available, logbooks + current, PAGESIZE / 2);
+		memcpy (profiles + offset, logbooks + current, PAGESIZE / 2);
 
-		unsigned char *p = profiles + offset + available;
+		unsigned char *p = profiles + offset;
 		if (callback && !callback (p, rb_entry_size + PAGESIZE / 2, p, PAGESIZE / 2, userdata)) {
+			rbstream_free (rbstream);
 			free (logbooks);
 			free (profiles);
 			return DEVICE_STATUS_SUCCESS;
 		}
 	}
 
+	rbstream_free (rbstream);
 	free (logbooks);
 	free (profiles);
 
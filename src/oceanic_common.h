@@ -56,6 +56,7 @@ typedef struct oceanic_common_device_t {
 	unsigned char fingerprint[PAGESIZE / 2];
 	const oceanic_common_layout_t *layout;
 	unsigned int multipage;
+	int probing;
 } oceanic_common_device_t;
 
 int
@@ -64,12 +65,27 @@ oceanic_common_match (const unsigned char *pattern, const unsigned char *string,
 void
 oceanic_common_device_init (oceanic_common_device_t *device, const device_backend_t *backend);
 
+device_status_t
+oceanic_common_device_probe_multipage (device_t *device, unsigned int maximum);
+
+device_status_t
+oceanic_atom2_device_open_timeout (device_t **device, const char* name, unsigned int timeout);
+
+device_status_t
+oceanic_veo250_device_open_timeout (device_t **device, const char* name, unsigned int timeout);
+
+device_status_t
+oceanic_vtpro_device_open_timeout (device_t **device, const char* name, unsigned int timeout);
+
 device_status_t
 oceanic_common_device_set_fingerprint (device_t *device, const unsigned char data[], unsigned int size);
 
 device_status_t
 oceanic_common_device_dump (device_t *abstract, dc_buffer_t *buffer);
 
+device_status_t
+oceanic_common_device_dump_delta (device_t *abstract, const unsigned char previous[], unsigned int size, dc_buffer_t *buffer);
+
 device_status_t
 oceanic_common_device_foreach (device_t *device, dive_callback_t callback, void *userdata);
 
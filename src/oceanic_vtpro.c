@@ -31,8 +31,9 @@
 #include "ringbuffer.h"
 #include "checksum.h"
 
-#define MAXRETRIES 2
-#define MULTIPAGE  4
+#define MAXRETRIES   2
+#define MULTIPAGE    4
+#define MAXMULTIPAGE 16
 
 #define EXITCODE(rc) \
 ( \
@@ -60,6 +61,8 @@ static const device_backend_t oceanic_vtpro_device_backend = {
 	oceanic_vtpro_device_read, /* read */
 	NULL, /* write */
 	oceanic_common_device_dump, /* dump */
+	NULL, /* dump_to */
+	oceanic_common_device_dump_delta, /* dump_delta */
 	oceanic_common_device_foreach, /* foreach */
 	oceanic_vtpro_device_close /* close */
 };
@@ -243,6 +246,13 @@ oceanic_vtpro_calibrate (oceanic_vtpro_device_t *device)
 
 device_status_t
 oceanic_vtpro_device_open (device_t **out, const char* name)
+{
+	return oceanic_vtpro_device_open_timeout (out, name, 0);
+}
+
+
+device_status_t
+oceanic_vtpro_device_open_timeout (device_t **out, const char* name, unsigned int timeout)
 {
 	if (out == NULL)
 		return DEVICE_STATUS_ERROR;
@@ -272,6 +282,9 @@ oceanic_vtpro_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
+	// Record the traffic in the trace buffer.
+	serial_set_trace (device->port, device_get_trace ((device_t *) device));
+
 	// Set the serial communication protocol (9600 8N1).
 	rc = serial_configure (device->port, 9600, 8, SERIAL_PARITY_NONE, 1, SERIAL_FLOWCONTROL_NONE);
 	if (rc == -1) {
@@ -281,8 +294,9 @@ oceanic_vtpro_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
-	// Set the timeout for receiving data (3000 ms).
-	if (serial_set_timeout (device->port, 3000) == -1) {
+	// Set the timeout for receiving data (3000 ms), or the
+	// shorter timeout that was requested to identify the device.
+	if (serial_set_timeout (device->port, timeout ? timeout : 3000) == -1) {
 		WARNING ("Failed to set the timeout.");
 		serial_close (device->port);
 		free (device);
@@ -322,6 +336,14 @@ oceanic_vtpro_device_open (device_t **out, const char* name)
 		return status;
 	}
 
+	// Restore the normal timeout, now that the device is identified.
+	if (timeout && serial_set_timeout (device->port, 3000) == -1) {
+		WARNING ("Failed to set the timeout.");
+		serial_close (device->port);
+		free (device);
+		return DEVICE_STATUS_IO;
+	}
+
 	// Calibrate the device. Although calibration is optional, it's highly
 	// recommended because it reduces the transfer time considerably, even
 	// when processing the command itself is quite slow.
@@ -338,6 +360,18 @@ oceanic_vtpro_device_open (device_t **out, const char* name)
 	else
 		device->base.layout = &oceanic_vtpro_layout;
 
+	// Set the memory size for the cache.
+	device_set_memory ((device_t *) device, device->base.layout->memsize, PAGESIZE);
+	device_allow_checkpoint ((device_t *) device);
+
+	// Detect the largest supported multipage size.
+	status = oceanic_common_device_probe_multipage ((device_t *) device, MAXMULTIPAGE);
+	if (status != DEVICE_STATUS_SUCCESS) {
+		serial_close (device->port);
+		free (device);
+		return status;
+	}
+
 	*out = (device_t*) device;
 
 	return DEVICE_STATUS_SUCCESS;
@@ -468,17 +502,18 @@ oceanic_vtpro_device_read (device_t *abstract, unsigned int address, unsigned ch
 	// The data transmission is split in packages
 	// of maximum $PAGESIZE bytes.
 
+	int retried = 0;
 	unsigned int nbytes = 0;
 	while (nbytes < size) {
 		// Calculate the number of packages.
 		unsigned int npackets = (size - nbytes) / PAGESIZE;
-		if (npackets > MULTIPAGE)
-			npackets = MULTIPAGE;
+		if (npackets > device->base.multipage)
+			npackets = device->base.multipage;
 
 		// Read the package.
 		unsigned int first =  address / PAGESIZE;
 		unsigned int last  = first + npackets - 1;
-		unsigned char answer[(PAGESIZE + 1) * MULTIPAGE] = {0};
+		unsigned char answer[(PAGESIZE + 1) * MAXMULTIPAGE] = {0};
 		unsigned char command[6] = {0x34,
 				(first >> 8) & 0xFF, // high
 				(first     ) & 0xFF, // low
@@ -486,8 +521,27 @@ oceanic_vtpro_device_read (device_t *abstract, unsigned int address, unsigned ch
 				(last     ) & 0xFF, // low
 				0x00};
 		device_status_t rc = oceanic_vtpro_transfer (device, command, sizeof (command), answer, (PAGESIZE + 1) * npackets);
-		if (rc != DEVICE_STATUS_SUCCESS)
+		if (rc != DEVICE_STATUS_SUCCESS) {
+			// Fall back to the default multipage size when the device
+			// does not accept larger requests. A single failure can be
+			// a transient error, so the request is retried once first,
+			// except while probing the multipage size. The input buffer
+			// is flushed to discard the late bytes of the failed answer.
+			if ((rc == DEVICE_STATUS_PROTOCOL || rc == DEVICE_STATUS_TIMEOUT) && npackets > MULTIPAGE) {
+				serial_flush (device->port, SERIAL_QUEUE_INPUT);
+				if (!retried && !device->base.probing) {
+					retried = 1;
+					continue;
+				}
+				WARNING ("Multipage request rejected.");
+				device->base.multipage = MULTIPAGE;
+				retried = 0;
+				continue;
+			}
 			return rc;
+		}
+
+		retried = 0;
 
 		unsigned int offset = 0;
 		for (unsigned int i = 0; i < npackets; ++i) {
@@ -37,8 +37,13 @@ struct parser_t {
 	const parser_backend_t *backend;
 	const unsigned char *data;
 	unsigned int size;
+	unsigned int sample_mask;
 };
 
+// Check whether the application requested a sample type. Backends can
+// use this to skip the decoding of samples that are not requested.
+#define SAMPLE_ENABLED(parser,type) (((parser)->sample_mask & SAMPLE_MASK (type)) != 0)
+
 struct parser_backend_t {
 	parser_type_t type;
 
@@ -30,6 +30,7 @@ parser_init (parser_t *parser, const parser_backend_t *backend)
 	parser->backend = backend;
 	parser->data = NULL;
 	parser->size = 0;
+	parser->sample_mask = SAMPLE_MASK_ALL;
 }
 
 
@@ -59,6 +60,18 @@ parser_set_data (parser_t *parser, const unsigned char *data, unsigned int size)
 }
 
 
+parser_status_t
+parser_set_sample_mask (parser_t *parser, unsigned int mask)
+{
+	if (parser == NULL)
+		return PARSER_STATUS_UNSUPPORTED;
+
+	parser->sample_mask = mask;
+
+	return PARSER_STATUS_SUCCESS;
+}
+
+
 parser_status_t
 parser_get_datetime (parser_t *parser, dc_datetime_t *datetime)
 {
@@ -72,6 +85,23 @@ parser_get_datetime (parser_t *parser, dc_datetime_t *datetime)
 }
 
 
+typedef struct parser_sample_filter_t {
+	unsigned int mask;
+	sample_callback_t callback;
+	void *userdata;
+} parser_sample_filter_t;
+
+
+static void
+parser_sample_filter (parser_sample_type_t type, parser_sample_value_t value, void *userdata)
+{
+	parser_sample_filter_t *filter = (parser_sample_filter_t *) userdata;
+
+	if (filter->mask & SAMPLE_MASK (type))
+		filter->callback (type, value, filter->userdata);
+}
+
+
 parser_status_t
 parser_samples_foreach (parser_t *parser, sample_callback_t callback, void *userdata)
 {
@@ -81,7 +111,14 @@ parser_samples_foreach (parser_t *parser, sample_callback_t callback, void *user
 	if (parser->backend->samples_foreach == NULL)
 		return PARSER_STATUS_UNSUPPORTED;
 
-	return parser->backend->samples_foreach (parser, callback, userdata);
+	if (callback == NULL || parser->sample_mask == SAMPLE_MASK_ALL)
+		return parser->backend->samples_foreach (parser, callback, userdata);
+
+	// Not all backends skip the samples that are not requested, so
+	// the remaining ones are filtered out before they are delivered.
+	parser_sample_filter_t filter = {parser->sample_mask, callback, userdata};
+
+	return parser->backend->samples_foreach (parser, parser_sample_filter, &filter);
 }
 
 
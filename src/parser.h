@@ -67,6 +67,9 @@ typedef enum parser_sample_type_t {
 	SAMPLE_TYPE_VENDOR
 } parser_sample_type_t;
 
+#define SAMPLE_MASK(type) (1u << (type))
+#define SAMPLE_MASK_ALL 0xFFFFFFFFu
+
 typedef enum parser_sample_event_t {
 	SAMPLE_EVENT_NONE,
 	SAMPLE_EVENT_DECOSTOP,
@@ -144,6 +147,9 @@ parser_get_type (parser_t *device);
 parser_status_t
 parser_set_data (parser_t *parser, const unsigned char *data, unsigned int size);
 
+parser_status_t
+parser_set_sample_mask (parser_t *parser, unsigned int mask);
+
 parser_status_t
 parser_get_datetime (parser_t *parser, dc_datetime_t *datetime);
 
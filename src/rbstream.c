@@ -0,0 +1,196 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2009 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+
+#include <string.h> // memcpy
+#include <stdlib.h> // malloc, free
+#include <assert.h> // assert
+
+#include "rbstream.h"
+#include "device-private.h"
+#include "utils.h"
+
+// The ringbuffer stream reads the data in a ringbuffer backwards, starting
+// from the most recent data. To reduce the number of read operations, the
+// data is always transferred in packets with the largest possible size. The
+// bytes of a packet that are not requested yet, are kept in a cache, where
+// they are available for the next read request.
+
+struct rbstream_t {
+	device_t *device;
+	// Transfer parameters.
+	unsigned int packetsize;
+	unsigned int minimum;
+	// Ringbuffer boundaries.
+	unsigned int begin;
+	unsigned int end;
+	// Current position.
+	unsigned int address;
+	// Number of bytes not transferred yet.
+	unsigned int remaining;
+	// Packet cache.
+	unsigned int available;
+	unsigned int skip;
+	unsigned char cache[];
+};
+
+
+device_status_t
+rbstream_new (rbstream_t **out, device_t *device, unsigned int pagesize, unsigned int packetsize, unsigned int minimum, unsigned int begin, unsigned int end, unsigned int address, unsigned int size)
+{
+	if (out == NULL || pagesize == 0 || packetsize == 0)
+		return DEVICE_STATUS_ERROR;
+
+	// Sanity check for the ringbuffer boundaries.
+	if (begin >= end || address < begin || address > end ||
+		size > end - begin) {
+		WARNING ("Invalid ringbuffer boundaries.");
+		return DEVICE_STATUS_ERROR;
+	}
+
+	// All addresses need to be aligned to page boundaries, and the
+	// packets need to contain a whole number of pages.
+	if (begin % pagesize != 0 || end % pagesize != 0 ||
+		address % pagesize != 0 || packetsize % pagesize != 0) {
+		WARNING ("Unaligned ringbuffer or packet size.");
+		return DEVICE_STATUS_ERROR;
+	}
+
+	// The padding bytes for short packets are read from the memory
+	// in front of the packet, which needs to be present.
+	if (minimum > begin) {
+		WARNING ("Invalid minimum packet size.");
+		return DEVICE_STATUS_ERROR;
+	}
+
+	// Allocate memory.
+	unsigned int cachesize = (packetsize > minimum ? packetsize : minimum);
+	rbstream_t *rbstream = (rbstream_t *) malloc (sizeof (rbstream_t) + cachesize);
+	if (rbstream == NULL) {
+		WARNING ("Failed to allocate memory.");
+		return DEVICE_STATUS_MEMORY;
+	}
+
+	rbstream->device = device;
+	rbstream->packetsize = packetsize;
+	rbstream->minimum = minimum;
+	rbstream->begin = begin;
+	rbstream->end = end;
+	rbstream->address = address;
+	rbstream->remaining = size;
+	rbstream->available = 0;
+	rbstream->skip = 0;
+
+	*out = rbstream;
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
+static device_status_t
+rbstream_fill (rbstream_t *rbstream)
+{
+	// Handle the ringbuffer wrap point.
+	if (rbstream->address == rbstream->begin)
+		rbstream->address = rbstream->end;
+
+	// Calculate the packet size. Try with the largest possible
+	// size first, and adjust when the end of the ringbuffer or
+	// the end of the data is reached.
+	unsigned int len = rbstream->packetsize;
+	if (rbstream->begin + len > rbstream->address)
+		len = rbstream->address - rbstream->begin; // End of ringbuffer.
+	if (len > rbstream->remaining)
+		len = rbstream->remaining; // End of data.
+
+	// Move to the begin of the current packet.
+	rbstream->address -= len;
+
+	// Always read at least the minimum amount of bytes. The extra
+	// bytes in front of the packet are ignored, because the data
+	// is read backwards.
+	unsigned int extra = 0;
+	if (len < rbstream->minimum)
+		extra = rbstream->minimum - len;
+
+	// Read the packet into the cache.
+	device_status_t rc = device_read (rbstream->device,
+		rbstream->address - extra, rbstream->cache, len + extra);
+	if (rc != DEVICE_STATUS_SUCCESS)
+		return rc;
+
+	rbstream->remaining -= len;
+	rbstream->available = len;
+	rbstream->skip = extra;
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
+device_status_t
+rbstream_read (rbstream_t *rbstream, device_progress_t *progress, unsigned char data[], unsigned int size)
+{
+	assert (rbstream != NULL);
+
+	if (size > rbstream->available + rbstream->remaining) {
+		WARNING ("Read beyond the end of the ringbuffer stream.");
+		return DEVICE_STATUS_ERROR;
+	}
+
+	// The data is returned in its natural order, but the
+	// buffer is filled backwards, one packet at a time.
+	unsigned int offset = size;
+	while (offset) {
+		// Transfer a new packet if the cache is empty.
+		if (rbstream->available == 0) {
+			device_status_t rc = rbstream_fill (rbstream);
+			if (rc != DEVICE_STATUS_SUCCESS)
+				return rc;
+
+			// Update and emit a progress event.
+			if (progress) {
+				progress->current += rbstream->available;
+				device_event_emit (rbstream->device, DEVICE_EVENT_PROGRESS, progress);
+			}
+		}
+
+		// Copy the most recent bytes from the cache.
+		unsigned int len = rbstream->available;
+		if (len > offset)
+			len = offset;
+
+		offset -= len;
+		rbstream->available -= len;
+
+		memcpy (data + offset, rbstream->cache + rbstream->skip + rbstream->available, len);
+	}
+
+	return DEVICE_STATUS_SUCCESS;
+}
+
+
+device_status_t
+rbstream_free (rbstream_t *rbstream)
+{
+	free (rbstream);
+
+	return DEVICE_STATUS_SUCCESS;
+}
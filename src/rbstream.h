@@ -0,0 +1,46 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2009 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+
+#ifndef RBSTREAM_H
+#define RBSTREAM_H
+
+#include "device-private.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct rbstream_t rbstream_t;
+
+device_status_t
+rbstream_new (rbstream_t **out, device_t *device, unsigned int pagesize, unsigned int packetsize, unsigned int minimum, unsigned int begin, unsigned int end, unsigned int address, unsigned int size);
+
+device_status_t
+rbstream_read (rbstream_t *rbstream, device_progress_t *progress, unsigned char data[], unsigned int size);
+
+device_status_t
+rbstream_free (rbstream_t *rbstream);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* RBSTREAM_H */
@@ -0,0 +1,44 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2009 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+
+#ifndef REEFNET_COMMON_H
+#define REEFNET_COMMON_H
+
+#include "device-private.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+device_status_t
+reefnet_sensus_device_open_timeout (device_t **device, const char* name, unsigned int timeout);
+
+device_status_t
+reefnet_sensuspro_device_open_timeout (device_t **device, const char* name, unsigned int timeout);
+
+device_status_t
+reefnet_sensusultra_device_open_timeout (device_t **device, const char* name, unsigned int timeout);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* REEFNET_COMMON_H */
@@ -24,6 +24,7 @@
 #include <assert.h> // assert
 
 #include "device-private.h"
+#include "reefnet_common.h"
 #include "reefnet_sensus.h"
 #include "serial.h"
 #include "checksum.h"
@@ -49,6 +50,7 @@ static device_status_t reefnet_sensus_device_set_fingerprint (device_t *abstract
 static device_status_t reefnet_sensus_device_dump (device_t *abstract, dc_buffer_t *buffer);
 static device_status_t reefnet_sensus_device_foreach (device_t *abstract, dive_callback_t callback, void *userdata);
 static device_status_t reefnet_sensus_device_close (device_t *abstract);
+static device_status_t reefnet_sensus_handshake (reefnet_sensus_device_t *device);
 
 static const device_backend_t reefnet_sensus_device_backend = {
 	DEVICE_TYPE_REEFNET_SENSUS,
@@ -57,6 +59,8 @@ static const device_backend_t reefnet_sensus_device_backend = {
 	NULL, /* read */
 	NULL, /* write */
 	reefnet_sensus_device_dump, /* dump */
+	NULL, /* dump_to */
+	NULL, /* dump_delta */
 	reefnet_sensus_device_foreach, /* foreach */
 	reefnet_sensus_device_close /* close */
 };
@@ -91,6 +95,13 @@ reefnet_sensus_cancel (reefnet_sensus_device_t *device)
 
 device_status_t
 reefnet_sensus_device_open (device_t **out, const char* name)
+{
+	return reefnet_sensus_device_open_timeout (out, name, 0);
+}
+
+
+device_status_t
+reefnet_sensus_device_open_timeout (device_t **out, const char* name, unsigned int timeout)
 {
 	if (out == NULL)
 		return DEVICE_STATUS_ERROR;
@@ -121,6 +132,9 @@ reefnet_sensus_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
+	// Record the traffic in the trace buffer.
+	serial_set_trace (device->port, device_get_trace ((device_t *) device));
+
 	// Set the serial communication protocol (19200 8N1).
 	rc = serial_configure (device->port, 19200, 8, SERIAL_PARITY_NONE, 1, SERIAL_FLOWCONTROL_NONE);
 	if (rc == -1) {
@@ -130,8 +144,9 @@ reefnet_sensus_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
-	// Set the timeout for receiving data (3000 ms).
-	if (serial_set_timeout (device->port, 3000) == -1) {
+	// Set the timeout for receiving data (3000 ms), or the
+	// shorter timeout that was requested to identify the device.
+	if (serial_set_timeout (device->port, timeout ? timeout : 3000) == -1) {
 		WARNING ("Failed to set the timeout.");
 		serial_close (device->port);
 		free (device);
@@ -141,6 +156,29 @@ reefnet_sensus_device_open (device_t **out, const char* name)
 	// Make sure everything is in a sane state.
 	serial_flush (device->port, SERIAL_QUEUE_BOTH);
 
+	// Identify the device with a handshake, and
+	// restore the normal timeout afterwards.
+	if (timeout) {
+		device_status_t status = reefnet_sensus_handshake (device);
+
+		// The download starts with a new handshake, so the
+		// device is released from the waiting state again.
+		if (status == DEVICE_STATUS_SUCCESS)
+			status = reefnet_sensus_cancel (device);
+		if (status != DEVICE_STATUS_SUCCESS) {
+			serial_close (device->port);
+			free (device);
+			return status;
+		}
+
+		if (serial_set_timeout (device->port, 3000) == -1) {
+			WARNING ("Failed to set the timeout.");
+			serial_close (device->port);
+			free (device);
+			return DEVICE_STATUS_IO;
+		}
+	}
+
 	*out = (device_t*) device;
 
 	return DEVICE_STATUS_SUCCESS;
@@ -292,8 +330,8 @@ reefnet_sensus_device_dump (device_t *abstract, dc_buffer_t *buffer)
 		return DEVICE_STATUS_TYPE_MISMATCH;
 
 	// Erase the current contents of the buffer and
-	// pre-allocate the required amount of memory.
-	if (!dc_buffer_clear (buffer) || !dc_buffer_reserve (buffer, REEFNET_SENSUS_MEMORY_SIZE)) {
+	// allocate the required amount of memory.
+	if (!dc_buffer_clear (buffer) || !dc_buffer_resize (buffer, REEFNET_SENSUS_MEMORY_SIZE)) {
 		WARNING ("Insufficient buffer space available.");
 		return DEVICE_STATUS_MEMORY;
 	}
@@ -319,20 +357,43 @@ reefnet_sensus_device_dump (device_t *abstract, dc_buffer_t *buffer)
 	// The device leaves the waiting state.
 	device->waiting = 0;
 
-	// Receive the answer from the device.
+	// Receive the header of the package.
+	unsigned char header[4] = {0};
+	n = serial_read (device->port, header, sizeof (header));
+	if (n != sizeof (header)) {
+		WARNING ("Failed to receive the answer.");
+		return EXITCODE (n);
+	}
+
+	// Update and emit a progress event.
+	progress.current += sizeof (header);
+	device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
+
+	// Verify the header of the package.
+	if (memcmp (header, "DATA", 4) != 0) {
+		WARNING ("Unexpected answer start byte(s).");
+		return DEVICE_STATUS_PROTOCOL;
+	}
+
+	// Receive the data directly into the output buffer,
+	// and update the checksum as the data arrives.
+	unsigned char *data = dc_buffer_get_data (buffer);
+	unsigned short ccrc = 0x00;
+
 	unsigned int nbytes = 0;
-	unsigned char answer[4 + REEFNET_SENSUS_MEMORY_SIZE + 2 + 3] = {0};
-	while (nbytes < sizeof (answer)) {
-		unsigned int len = sizeof (answer) - nbytes;
+	while (nbytes < REEFNET_SENSUS_MEMORY_SIZE) {
+		unsigned int len = REEFNET_SENSUS_MEMORY_SIZE - nbytes;
 		if (len > 128)
 			len = 128;
 
-		n = serial_read (device->port, answer + nbytes, len);
+		n = serial_read (device->port, data + nbytes, len);
 		if (n != len) {
 			WARNING ("Failed to receive the answer.");
 			return EXITCODE (n);
 		}
 
+		ccrc = checksum_add_uint16 (data + nbytes, len, ccrc);
+
 		// Update and emit a progress event.
 		progress.current += len;
 		device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
@@ -340,23 +401,31 @@ reefnet_sensus_device_dump (device_t *abstract, dc_buffer_t *buffer)
 		nbytes += len;
 	}
 
-	// Verify the headers of the package.
-	if (memcmp (answer, "DATA", 4) != 0 ||
-		memcmp (answer + sizeof (answer) - 3, "END", 3) != 0) {
-		WARNING ("Unexpected answer start or end byte(s).");
+	// Receive the checksum and trailer of the package.
+	unsigned char trailer[2 + 3] = {0};
+	n = serial_read (device->port, trailer, sizeof (trailer));
+	if (n != sizeof (trailer)) {
+		WARNING ("Failed to receive the answer.");
+		return EXITCODE (n);
+	}
+
+	// Update and emit a progress event.
+	progress.current += sizeof (trailer);
+	device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
+
+	// Verify the trailer of the package.
+	if (memcmp (trailer + 2, "END", 3) != 0) {
+		WARNING ("Unexpected answer end byte(s).");
 		return DEVICE_STATUS_PROTOCOL;
 	}
 
 	// Verify the checksum of the package.
-	unsigned short crc = array_uint16_le (answer + 4 + REEFNET_SENSUS_MEMORY_SIZE);
-	unsigned short ccrc = checksum_add_uint16 (answer + 4, REEFNET_SENSUS_MEMORY_SIZE, 0x00);
+	unsigned short crc = array_uint16_le (trailer);
 	if (crc != ccrc) {
 		WARNING ("Unexpected answer CRC.");
 		return DEVICE_STATUS_PROTOCOL;
 	}
 
-	dc_buffer_append (buffer, answer + 4, REEFNET_SENSUS_MEMORY_SIZE);
-
 	return DEVICE_STATUS_SUCCESS;
 }
 
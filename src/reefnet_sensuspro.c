@@ -23,6 +23,7 @@
 #include <stdlib.h> // malloc, free
 
 #include "device-private.h"
+#include "reefnet_common.h"
 #include "reefnet_sensuspro.h"
 #include "serial.h"
 #include "checksum.h"
@@ -47,6 +48,7 @@ static device_status_t reefnet_sensuspro_device_set_fingerprint (device_t *abstr
 static device_status_t reefnet_sensuspro_device_dump (device_t *abstract, dc_buffer_t *buffer);
 static device_status_t reefnet_sensuspro_device_foreach (device_t *abstract, dive_callback_t callback, void *userdata);
 static device_status_t reefnet_sensuspro_device_close (device_t *abstract);
+static device_status_t reefnet_sensuspro_handshake (reefnet_sensuspro_device_t *device);
 
 static const device_backend_t reefnet_sensuspro_device_backend = {
 	DEVICE_TYPE_REEFNET_SENSUSPRO,
@@ -55,6 +57,8 @@ static const device_backend_t reefnet_sensuspro_device_backend = {
 	NULL, /* read */
 	NULL, /* write */
 	reefnet_sensuspro_device_dump, /* dump */
+	NULL, /* dump_to */
+	NULL, /* dump_delta */
 	reefnet_sensuspro_device_foreach, /* foreach */
 	reefnet_sensuspro_device_close /* close */
 };
@@ -71,6 +75,13 @@ device_is_reefnet_sensuspro (device_t *abstract)
 
 device_status_t
 reefnet_sensuspro_device_open (device_t **out, const char* name)
+{
+	return reefnet_sensuspro_device_open_timeout (out, name, 0);
+}
+
+
+device_status_t
+reefnet_sensuspro_device_open_timeout (device_t **out, const char* name, unsigned int timeout)
 {
 	if (out == NULL)
 		return DEVICE_STATUS_ERROR;
@@ -100,6 +111,9 @@ reefnet_sensuspro_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
+	// Record the traffic in the trace buffer.
+	serial_set_trace (device->port, device_get_trace ((device_t *) device));
+
 	// Set the serial communication protocol (19200 8N1).
 	rc = serial_configure (device->port, 19200, 8, SERIAL_PARITY_NONE, 1, SERIAL_FLOWCONTROL_NONE);
 	if (rc == -1) {
@@ -109,8 +123,9 @@ reefnet_sensuspro_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
-	// Set the timeout for receiving data (3000ms).
-	if (serial_set_timeout (device->port, 3000) == -1) {
+	// Set the timeout for receiving data (3000ms), or the
+	// shorter timeout that was requested to identify the device.
+	if (serial_set_timeout (device->port, timeout ? timeout : 3000) == -1) {
 		WARNING ("Failed to set the timeout.");
 		serial_close (device->port);
 		free (device);
@@ -120,6 +135,24 @@ reefnet_sensuspro_device_open (device_t **out, const char* name)
 	// Make sure everything is in a sane state.
 	serial_flush (device->port, SERIAL_QUEUE_BOTH);
 
+	// Identify the device with a handshake, and
+	// restore the normal timeout afterwards.
+	if (timeout) {
+		device_status_t status = reefnet_sensuspro_handshake (device);
+		if (status != DEVICE_STATUS_SUCCESS) {
+			serial_close (device->port);
+			free (device);
+			return status;
+		}
+
+		if (serial_set_timeout (device->port, 3000) == -1) {
+			WARNING ("Failed to set the timeout.");
+			serial_close (device->port);
+			free (device);
+			return DEVICE_STATUS_IO;
+		}
+	}
+
 	*out = (device_t*) device;
 
 	return DEVICE_STATUS_SUCCESS;
@@ -219,7 +252,7 @@ reefnet_sensuspro_handshake (reefnet_sensuspro_device_t *device)
 
 	// Verify the checksum of the handshake packet.
 	unsigned short crc = array_uint16_le (handshake + REEFNET_SENSUSPRO_HANDSHAKE_SIZE);
-	unsigned short ccrc = checksum_crc_ccitt_uint16 (handshake, REEFNET_SENSUSPRO_HANDSHAKE_SIZE);
+	unsigned short ccrc = checksum_crc_ccitt_uint16 (handshake, REEFNET_SENSUSPRO_HANDSHAKE_SIZE, 0xffff);
 	if (crc != ccrc) {
 		WARNING ("Unexpected answer CRC.");
 		return DEVICE_STATUS_PROTOCOL;
@@ -279,8 +312,8 @@ reefnet_sensuspro_device_dump (device_t *abstract, dc_buffer_t *buffer)
 		return DEVICE_STATUS_TYPE_MISMATCH;
 
 	// Erase the current contents of the buffer and
-	// pre-allocate the required amount of memory.
-	if (!dc_buffer_clear (buffer) || !dc_buffer_reserve (buffer, REEFNET_SENSUSPRO_MEMORY_SIZE)) {
+	// allocate the required amount of memory.
+	if (!dc_buffer_clear (buffer) || !dc_buffer_resize (buffer, REEFNET_SENSUSPRO_MEMORY_SIZE)) {
 		WARNING ("Insufficient buffer space available.");
 		return DEVICE_STATUS_MEMORY;
 	}
@@ -295,19 +328,25 @@ reefnet_sensuspro_device_dump (device_t *abstract, dc_buffer_t *buffer)
 	if (rc != DEVICE_STATUS_SUCCESS)
 		return rc;
 
+	// Receive the data directly into the output buffer,
+	// and update the checksum as the data arrives.
+	unsigned char *data = dc_buffer_get_data (buffer);
+	unsigned short ccrc = 0xffff;
+
 	unsigned int nbytes = 0;
-	unsigned char answer[REEFNET_SENSUSPRO_MEMORY_SIZE + 2] = {0};
-	while (nbytes < sizeof (answer)) {
-		unsigned int len = sizeof (answer) - nbytes;
+	while (nbytes < REEFNET_SENSUSPRO_MEMORY_SIZE) {
+		unsigned int len = REEFNET_SENSUSPRO_MEMORY_SIZE - nbytes;
 		if (len > 256)
 			len = 256;
 
-		int n = serial_read (device->port, answer + nbytes, len);
+		int n = serial_read (device->port, data + nbytes, len);
 		if (n != len) {
 			WARNING ("Failed to receive the answer.");
 			return EXITCODE (n);
 		}
 
+		ccrc = checksum_crc_ccitt_uint16 (data + nbytes, len, ccrc);
+
 		// Update and emit a progress event.
 		progress.current += len;
 		device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
@@ -315,15 +354,24 @@ reefnet_sensuspro_device_dump (device_t *abstract, dc_buffer_t *buffer)
 		nbytes += len;
 	}
 
-	unsigned short crc = array_uint16_le (answer + REEFNET_SENSUSPRO_MEMORY_SIZE);
-	unsigned short ccrc = checksum_crc_ccitt_uint16 (answer, REEFNET_SENSUSPRO_MEMORY_SIZE);
+	// Receive the checksum.
+	unsigned char checksum[2] = {0};
+	int n = serial_read (device->port, checksum, sizeof (checksum));
+	if (n != sizeof (checksum)) {
+		WARNING ("Failed to receive the answer.");
+		return EXITCODE (n);
+	}
+
+	// Update and emit a progress event.
+	progress.current += sizeof (checksum);
+	device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
+
+	unsigned short crc = array_uint16_le (checksum);
 	if (crc != ccrc) {
 		WARNING ("Unexpected answer CRC.");
 		return DEVICE_STATUS_PROTOCOL;
 	}
 
-	dc_buffer_append (buffer, answer, REEFNET_SENSUSPRO_MEMORY_SIZE);
-
 	return DEVICE_STATUS_SUCCESS;
 }
 
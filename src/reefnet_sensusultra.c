@@ -24,6 +24,7 @@
 #include <assert.h> // assert
 
 #include "device-private.h"
+#include "reefnet_common.h"
 #include "reefnet_sensusultra.h"
 #include "serial.h"
 #include "checksum.h"
@@ -47,12 +48,17 @@ typedef struct reefnet_sensusultra_device_t {
 	unsigned int timestamp;
 	unsigned int devtime;
 	dc_ticks_t systime;
+	unsigned char user[REEFNET_SENSUSULTRA_MEMORY_USER_SIZE];
+	unsigned int userserial;
+	int uservalid;
 } reefnet_sensusultra_device_t;
 
 static device_status_t reefnet_sensusultra_device_set_fingerprint (device_t *abstract, const unsigned char data[], unsigned int size);
 static device_status_t reefnet_sensusultra_device_dump (device_t *abstract, dc_buffer_t *buffer);
+static device_status_t reefnet_sensusultra_device_dump_to (device_t *abstract, device_sink_callback_t callback, void *userdata);
 static device_status_t reefnet_sensusultra_device_foreach (device_t *abstract, dive_callback_t callback, void *userdata);
 static device_status_t reefnet_sensusultra_device_close (device_t *abstract);
+static device_status_t reefnet_sensusultra_handshake (reefnet_sensusultra_device_t *device);
 
 static const device_backend_t reefnet_sensusultra_device_backend = {
 	DEVICE_TYPE_REEFNET_SENSUSULTRA,
@@ -61,6 +67,8 @@ static const device_backend_t reefnet_sensusultra_device_backend = {
 	NULL, /* read */
 	NULL, /* write */
 	reefnet_sensusultra_device_dump, /* dump */
+	reefnet_sensusultra_device_dump_to, /* dump_to */
+	NULL, /* dump_delta */
 	reefnet_sensusultra_device_foreach, /* foreach */
 	reefnet_sensusultra_device_close /* close */
 };
@@ -77,6 +85,13 @@ device_is_reefnet_sensusultra (device_t *abstract)
 
 device_status_t
 reefnet_sensusultra_device_open (device_t **out, const char* name)
+{
+	return reefnet_sensusultra_device_open_timeout (out, name, 0);
+}
+
+
+device_status_t
+reefnet_sensusultra_device_open_timeout (device_t **out, const char* name, unsigned int timeout)
 {
 	if (out == NULL)
 		return DEVICE_STATUS_ERROR;
@@ -98,6 +113,8 @@ reefnet_sensusultra_device_open (device_t **out, const char* name)
 	device->systime = (dc_ticks_t) -1;
 	device->devtime = 0;
 	memset (device->handshake, 0, sizeof (device->handshake));
+	device->userserial = 0;
+	device->uservalid = 0;
 
 	// Open the device.
 	int rc = serial_open (&device->port, name);
@@ -107,6 +124,9 @@ reefnet_sensusultra_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
+	// Record the traffic in the trace buffer.
+	serial_set_trace (device->port, device_get_trace ((device_t *) device));
+
 	// Set the serial communication protocol (115200 8N1).
 	rc = serial_configure (device->port, 115200, 8, SERIAL_PARITY_NONE, 1, SERIAL_FLOWCONTROL_NONE);
 	if (rc == -1) {
@@ -116,8 +136,9 @@ reefnet_sensusultra_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
-	// Set the timeout for receiving data (3000ms).
-	if (serial_set_timeout (device->port, 3000) == -1) {
+	// Set the timeout for receiving data (3000ms), or the
+	// shorter timeout that was requested to identify the device.
+	if (serial_set_timeout (device->port, timeout ? timeout : 3000) == -1) {
 		WARNING ("Failed to set the timeout.");
 		serial_close (device->port);
 		free (device);
@@ -127,6 +148,24 @@ reefnet_sensusultra_device_open (device_t **out, const char* name)
 	// Make sure everything is in a sane state.
 	serial_flush (device->port, SERIAL_QUEUE_BOTH);
 
+	// Identify the device with a handshake, and
+	// restore the normal timeout afterwards.
+	if (timeout) {
+		device_status_t status = reefnet_sensusultra_handshake (device);
+		if (status != DEVICE_STATUS_SUCCESS) {
+			serial_close (device->port);
+			free (device);
+			return status;
+		}
+
+		if (serial_set_timeout (device->port, 3000) == -1) {
+			WARNING ("Failed to set the timeout.");
+			serial_close (device->port);
+			free (device);
+			return DEVICE_STATUS_IO;
+		}
+	}
+
 	*out = (device_t*) device;
 
 	return DEVICE_STATUS_SUCCESS;
@@ -287,9 +326,10 @@ reefnet_sensusultra_packet (reefnet_sensusultra_device_t *device, unsigned char
 
 	// Verify the checksum of the packet.
 	unsigned short crc = array_uint16_le (data + size - 2);
-	unsigned short ccrc = checksum_crc_ccitt_uint16 (data + header, size - header - 2);
+	unsigned short ccrc = checksum_crc_ccitt_uint16 (data + header, size - header - 2, 0xffff);
 	if (crc != ccrc) {
 		WARNING ("Unexpected answer CRC.");
+		device_stats_crc ((device_t *) device);
 		return DEVICE_STATUS_PROTOCOL;
 	}
 
@@ -354,9 +394,14 @@ reefnet_sensusultra_page (reefnet_sensusultra_device_t *device, unsigned char *d
 {
 	assert (size >= REEFNET_SENSUSULTRA_PACKET_SIZE + 4);
 
+	device_t *abstract = (device_t *) device;
+
 	unsigned int nretries = 0;
+	unsigned int timestamp = device_stats_begin (abstract);
 	device_status_t rc = DEVICE_STATUS_SUCCESS;
 	while ((rc = reefnet_sensusultra_packet (device, data, size, 2)) != DEVICE_STATUS_SUCCESS) {
+		device_stats_error (abstract, rc);
+
 		// Automatically discard a corrupted packet, 
 		// and request a new one.
 		if (rc != DEVICE_STATUS_PROTOCOL)
@@ -366,12 +411,16 @@ reefnet_sensusultra_page (reefnet_sensusultra_device_t *device, unsigned char *d
 		if (nretries++ >= device->maxretries)
 			return rc;
 
+		timestamp = device_stats_retry (abstract);
+
 		// Reject the packet.
 		rc = reefnet_sensusultra_send_uchar (device, REJECT);
 		if (rc != DEVICE_STATUS_SUCCESS)
 			return rc;
 	}
 
+	device_stats_end (abstract, timestamp);
+
 	// Verify the page number.
 	unsigned int page = array_uint16_le (data);
 	if (page != pagenum) {
@@ -403,18 +452,28 @@ reefnet_sensusultra_send (reefnet_sensusultra_device_t *device, unsigned short c
 static device_status_t
 reefnet_sensusultra_device_dump (device_t *abstract, dc_buffer_t *buffer)
 {
-	reefnet_sensusultra_device_t *device = (reefnet_sensusultra_device_t*) abstract;
-
 	if (! device_is_reefnet_sensusultra (abstract))
 		return DEVICE_STATUS_TYPE_MISMATCH;
 
 	// Erase the current contents of the buffer and
-	// pre-allocate the required amount of memory.
-	if (!dc_buffer_clear (buffer) || !dc_buffer_reserve (buffer, REEFNET_SENSUSULTRA_MEMORY_DATA_SIZE)) {
+	// allocate the required amount of memory.
+	if (!dc_buffer_clear (buffer) || !dc_buffer_resize (buffer, REEFNET_SENSUSULTRA_MEMORY_DATA_SIZE)) {
 		WARNING ("Insufficient buffer space available.");
 		return DEVICE_STATUS_MEMORY;
 	}
 
+	return reefnet_sensusultra_device_dump_to (abstract, device_sink_buffer, buffer);
+}
+
+
+static device_status_t
+reefnet_sensusultra_device_dump_to (device_t *abstract, device_sink_callback_t callback, void *userdata)
+{
+	reefnet_sensusultra_device_t *device = (reefnet_sensusultra_device_t*) abstract;
+
+	if (! device_is_reefnet_sensusultra (abstract))
+		return DEVICE_STATUS_TYPE_MISMATCH;
+
 	// Enable progress notifications.
 	device_progress_t progress = DEVICE_PROGRESS_INITIALIZER;
 	progress.maximum = REEFNET_SENSUSULTRA_MEMORY_DATA_SIZE;
@@ -438,10 +497,12 @@ reefnet_sensusultra_device_dump (device_t *abstract, dc_buffer_t *buffer)
 		progress.current += REEFNET_SENSUSULTRA_PACKET_SIZE;
 		device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
 
-		// Prepend the packet to the buffer.
-		if (!dc_buffer_prepend (buffer, packet + 2, REEFNET_SENSUSULTRA_PACKET_SIZE)) {
-			WARNING ("Insufficient buffer space available.");
-			return DEVICE_STATUS_MEMORY;
+		// Pass the packet to the sink. The packets are received in
+		// reverse order, starting with the most recent data.
+		unsigned int offset = REEFNET_SENSUSULTRA_MEMORY_DATA_SIZE - nbytes - REEFNET_SENSUSULTRA_PACKET_SIZE;
+		if (!callback (offset, packet + 2, REEFNET_SENSUSULTRA_PACKET_SIZE, userdata)) {
+			WARNING ("Failed to write the data.");
+			return DEVICE_STATUS_ERROR;
 		}
 
 		// Accept the packet.
@@ -496,6 +557,11 @@ reefnet_sensusultra_device_read_user (device_t *abstract, unsigned char *data, u
 		npages++;
 	}
 
+	// Remember the contents of the user memory.
+	memcpy (device->user, data, REEFNET_SENSUSULTRA_MEMORY_USER_SIZE);
+	device->userserial = array_uint16_le (device->handshake + 2);
+	device->uservalid = 1;
+
 	return DEVICE_STATUS_SUCCESS;
 }
 
@@ -513,24 +579,65 @@ reefnet_sensusultra_device_write_user (device_t *abstract, const unsigned char *
 		return DEVICE_STATUS_MEMORY;
 	}
 
-	// Wake-up the device and send the instruction code.
-	device_status_t rc = reefnet_sensusultra_send (device, 0xB430);
+	// Wake-up the device.
+	device_status_t rc = reefnet_sensusultra_handshake (device);
 	if (rc != DEVICE_STATUS_SUCCESS)
 		return rc;
 
-	// Send the data to the device.
-	for (unsigned int i = 0; i < REEFNET_SENSUSULTRA_MEMORY_USER_SIZE; ++i) {
-		rc = reefnet_sensusultra_send_uchar (device, data[i]);
-		if (rc != DEVICE_STATUS_SUCCESS)
-			return rc;
+	// The user memory can only be written as a whole, with one byte for
+	// each prompt byte, which is very slow. If the same device is already
+	// known to contain the new data (from a previous read or write in this
+	// session), the transfer is skipped entirely.
+	unsigned int serial = array_uint16_le (device->handshake + 2);
+	if (device->uservalid && device->userserial == serial &&
+		memcmp (device->user, data, REEFNET_SENSUSULTRA_MEMORY_USER_SIZE) == 0)
+		return DEVICE_STATUS_SUCCESS;
+
+	// The contents are unknown until the transfer is complete.
+	device->uservalid = 0;
+
+	// Send the instruction code.
+	rc = reefnet_sensusultra_send_ushort (device, 0xB430);
+	if (rc != DEVICE_STATUS_SUCCESS)
+		return rc;
+
+	// Enable progress notifications.
+	device_progress_t progress = DEVICE_PROGRESS_INITIALIZER;
+	progress.maximum = REEFNET_SENSUSULTRA_MEMORY_USER_SIZE;
+	device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
+
+	// Send the data to the device. Every byte needs to wait for its
+	// prompt byte, so the data is processed in blocks only to check
+	// for cancellation and to report the progress.
+	unsigned int nbytes = 0;
+	while (nbytes < REEFNET_SENSUSULTRA_MEMORY_USER_SIZE) {
+		if (device_is_cancelled (abstract))
+			return DEVICE_STATUS_CANCELLED;
+
+		for (unsigned int i = 0; i < REEFNET_SENSUSULTRA_PACKET_SIZE; ++i) {
+			rc = reefnet_sensusultra_send_uchar (device, data[nbytes + i]);
+			if (rc != DEVICE_STATUS_SUCCESS)
+				return rc;
+		}
+
+		// Update and emit a progress event.
+		progress.current += REEFNET_SENSUSULTRA_PACKET_SIZE;
+		device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
+
+		nbytes += REEFNET_SENSUSULTRA_PACKET_SIZE;
 	}
 
 	// Send the checksum to the device.
-	unsigned short crc = checksum_crc_ccitt_uint16 (data, REEFNET_SENSUSULTRA_MEMORY_USER_SIZE);
+	unsigned short crc = checksum_crc_ccitt_uint16 (data, REEFNET_SENSUSULTRA_MEMORY_USER_SIZE, 0xffff);
 	rc = reefnet_sensusultra_send_ushort (device, crc);
 	if (rc != DEVICE_STATUS_SUCCESS)
 		return rc;
 
+	// Remember the contents of the user memory.
+	memcpy (device->user, data, REEFNET_SENSUSULTRA_MEMORY_USER_SIZE);
+	device->userserial = serial;
+	device->uservalid = 1;
+
 	return DEVICE_STATUS_SUCCESS;
 }
 
@@ -692,7 +799,10 @@ reefnet_sensusultra_device_foreach (device_t *abstract, dive_callback_t callback
 	if (! device_is_reefnet_sensusultra (abstract))
 		return DEVICE_STATUS_TYPE_MISMATCH;
 
-	dc_buffer_t *buffer = dc_buffer_new (REEFNET_SENSUSULTRA_MEMORY_DATA_SIZE);
+	// The buffer contains only the data that has not been processed by the
+	// parser yet. Dives that have been passed to the callback are removed
+	// from the buffer, so it never grows much larger than a single dive.
+	dc_buffer_t *buffer = dc_buffer_new (0);
 	if (buffer == NULL) {
 		WARNING ("Memory allocation error.");
 		return DEVICE_STATUS_MEMORY;
@@ -736,6 +846,7 @@ reefnet_sensusultra_device_foreach (device_t *abstract, dive_callback_t callback
 		// Prepend the packet to the buffer.
 		if (!dc_buffer_prepend (buffer, packet + 2, REEFNET_SENSUSULTRA_PACKET_SIZE)) {
 			WARNING ("Insufficient buffer space available.");
+			dc_buffer_free (buffer);
 			return DEVICE_STATUS_MEMORY;
 		}
 
@@ -754,6 +865,10 @@ reefnet_sensusultra_device_foreach (device_t *abstract, dive_callback_t callback
 		if (aborted)
 			break;
 
+		// Discard the dives that have already been processed. Only
+		// the data in front of the most recent dive is still needed.
+		dc_buffer_slice (buffer, 0, previous);
+
 		// Accept the packet.
 		rc = reefnet_sensusultra_send_uchar (device, ACCEPT);
 		if (rc != DEVICE_STATUS_SUCCESS) {
@@ -159,11 +159,15 @@ reefnet_sensusultra_parser_samples_foreach (parser_t *abstract, sample_callback_
 		return PARSER_STATUS_TYPE_MISMATCH;
 
 	const unsigned char header[4] = {0x00, 0x00, 0x00, 0x00};
-	const unsigned char footer[4] = {0xFF, 0xFF, 0xFF, 0xFF};
 
 	const unsigned char *data = abstract->data;
 	unsigned int size = abstract->size;
 
+	// The callback can change the calibration through the parser, so
+	// without local copies the values are reloaded for every sample.
+	double atmospheric = parser->atmospheric;
+	double hydrostatic = parser->hydrostatic;
+
 	unsigned int offset = 0;
 	while (offset + sizeof (header) <= size) {
 		if (memcmp (data + offset, header, sizeof (header)) == 0) {
@@ -173,23 +177,27 @@ reefnet_sensusultra_parser_samples_foreach (parser_t *abstract, sample_callback_
 			unsigned int interval = array_uint16_le (data + offset + 8);
 
 			offset += 16;
-			while (offset + sizeof (footer) <= size && 
-				memcmp (data + offset, footer, sizeof (footer)) != 0) 
-			{
+			while (offset + 4 <= size) {
+				const unsigned char *p = data + offset;
 				parser_sample_value_t sample = {0};
 
+				// The profile is terminated with a 0xFFFFFFFF footer.
+				unsigned int value = array_uint32_le (p);
+				if (value == 0xFFFFFFFF)
+					break;
+
 				// Time (seconds)
 				sample.time = time;
 				if (callback) callback (SAMPLE_TYPE_TIME, sample, userdata);
 
 				// Temperature (0.01 °K)
-				unsigned int temperature = array_uint16_le (data + offset);
+				unsigned int temperature = value & 0xFFFF;
 				sample.temperature = temperature / 100.0 - 273.15;
 				if (callback) callback (SAMPLE_TYPE_TEMPERATURE, sample, userdata);
 
 				// Depth (absolute pressure in millibar)
-				unsigned int depth = array_uint16_le (data + offset + 2);
-				sample.depth = (depth * BAR / 1000.0 - parser->atmospheric) / parser->hydrostatic;
+				unsigned int depth = value >> 16;
+				sample.depth = (depth * BAR / 1000.0 - atmospheric) / hydrostatic;
 				if (callback) callback (SAMPLE_TYPE_DEPTH, sample, userdata);
 
 				time += interval;
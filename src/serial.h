@@ -28,6 +28,8 @@ extern "C" {
 
 typedef struct serial serial;
 
+struct trace_t;
+
 enum parity_t {
 	SERIAL_PARITY_NONE,
 	SERIAL_PARITY_EVEN,
@@ -79,6 +81,8 @@ int serial_configure (serial *device, int baudrate, int databits, int parity, in
 
 int serial_set_timeout (serial *device, long timeout /* milliseconds */);
 
+int serial_set_trace (serial *device, struct trace_t *trace);
+
 int serial_set_queue_size (serial *device, unsigned int input, unsigned int output);
 
 int serial_read (serial *device, void* data, unsigned int size);
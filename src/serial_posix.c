@@ -35,6 +35,7 @@
 
 #include "serial.h"
 #include "utils.h"
+#include "trace.h"
 
 #define TRACE(expr) \
 { \
@@ -50,6 +51,10 @@ struct serial {
 	 */
 	int fd;
 	long timeout;
+	/*
+	 * The trace buffer, to record all the transferred data.
+	 */
+	struct trace_t *trace;
 	/*
 	 * Serial port settings are saved into this variable immediately
 	 * after the port is opened. These settings are restored when the
@@ -93,6 +98,9 @@ serial_open (serial** out, const char* name)
 	// Default to blocking reads.
 	device->timeout = -1;
 
+	// Default to no tracing.
+	device->trace = NULL;
+
 	// Open the device in non-blocking mode, to return immediately
 	// without waiting for the modem connection to complete.
 	device->fd = open (name, O_RDWR | O_NOCTTY | O_NONBLOCK);
@@ -339,6 +347,18 @@ serial_set_timeout (serial *device, long timeout)
 }
 
 
+int
+serial_set_trace (serial *device, struct trace_t *trace)
+{
+	if (device == NULL)
+		return -1; // EINVAL (Invalid argument)
+
+	device->trace = trace;
+
+	return 0;
+}
+
+
 //
 // Configure the serial port (recommended size of the input/output buffers).
 //
@@ -487,6 +507,8 @@ serial_read (serial* device, void* data, unsigned int size)
 		}	
 	}
 
+	trace_append (device->trace, TRACE_DIRECTION_READ, data, nbytes);
+
 	return nbytes;
 }
 
@@ -522,6 +544,8 @@ serial_write (serial* device, const void* data, unsigned int size)
 			break; // Timeout.
 	}
 
+	trace_append (device->trace, TRACE_DIRECTION_WRITE, data, nbytes);
+
 	return nbytes;
 }
 
@@ -24,6 +24,7 @@
 
 #include "serial.h"
 #include "utils.h"
+#include "trace.h"
 
 #define TRACE(expr) \
 { \
@@ -45,6 +46,10 @@ struct serial {
 	 */
 	DCB dcb;
 	COMMTIMEOUTS timeouts;
+	/*
+	 * The trace buffer, to record all the transferred data.
+	 */
+	struct trace_t *trace;
 };
 
 //
@@ -98,6 +103,9 @@ serial_open (serial** out, const char* name)
 		return -1; // ERROR_OUTOFMEMORY (Not enough storage is available to complete this operation)
 	}
 
+	// Default to no tracing.
+	device->trace = NULL;
+
 	// Open the device.
 	device->hFile = CreateFileA (name, 
 			GENERIC_READ | GENERIC_WRITE, 0,
@@ -342,6 +350,18 @@ serial_set_queue_size (serial *device, unsigned int input, unsigned int output)
 	return 0;
 }
 
+int
+serial_set_trace (serial* device, struct trace_t *trace)
+{
+	if (device == NULL)
+		return -1; // ERROR_INVALID_PARAMETER (The parameter is incorrect)
+
+	device->trace = trace;
+
+	return 0;
+}
+
+
 int
 serial_read (serial* device, void* data, unsigned int size)
 {
@@ -354,6 +374,8 @@ serial_read (serial* device, void* data, unsigned int size)
 		return -1;
 	}
 
+	trace_append (device->trace, TRACE_DIRECTION_READ, data, dwRead);
+
 	return dwRead;
 }
 
@@ -370,6 +392,8 @@ serial_write (serial* device, const void* data, unsigned int size)
 		return -1;
 	}
 
+	trace_append (device->trace, TRACE_DIRECTION_WRITE, data, dwWritten);
+
 	return dwWritten;
 }
 
@@ -25,6 +25,7 @@
 #include "suunto_common2.h"
 #include "utils.h"
 #include "ringbuffer.h"
+#include "rbstream.h"
 #include "checksum.h"
 #include "array.h"
 
@@ -51,6 +52,11 @@ suunto_common2_device_init (suunto_common2_device_t *device, const suunto_common
 	// Initialize the base class.
 	device_init (&device->base, &backend->base);
 
+	// Reading fewer than the minimum amount of bytes is unreliable,
+	// so the cache uses pages of the minimum size.
+	device_set_memory (&device->base, SZ_MEMORY, SZ_MINIMUM);
+	device_allow_checkpoint (&device->base);
+
 	// Set the default values.
 	memset (device->fingerprint, 0, sizeof (device->fingerprint));
 }
@@ -70,8 +76,11 @@ suunto_common2_transfer (device_t *abstract, const unsigned char command[], unsi
 	// again during one of the retries.
 
 	unsigned int nretries = 0;
+	unsigned int timestamp = device_stats_begin (abstract);
 	device_status_t rc = DEVICE_STATUS_SUCCESS;
 	while ((rc = BACKEND (abstract)->packet (abstract, command, csize, answer, asize, size)) != DEVICE_STATUS_SUCCESS) {
+		device_stats_error (abstract, rc);
+
 		// Automatically discard a corrupted packet,
 		// and request a new one.
 		if (rc != DEVICE_STATUS_TIMEOUT && rc != DEVICE_STATUS_PROTOCOL)
@@ -80,8 +89,12 @@ suunto_common2_transfer (device_t *abstract, const unsigned char command[], unsi
 		// Abort if the maximum number of retries is reached.
 		if (nretries++ >= MAXRETRIES)
 			return rc;
+
+		timestamp = device_stats_retry (abstract);
 	}
 
+	device_stats_end (abstract, timestamp);
+
 	return rc;
 }
 
@@ -217,11 +230,140 @@ suunto_common2_device_dump (device_t *abstract, dc_buffer_t *buffer)
 		return DEVICE_STATUS_MEMORY;
 	}
 
+	// Pages restored from a checkpoint are only valid as long as
+	// the serial number and the ringbuffer pointers remain unchanged.
+	device_range_t areas[2] = {{0x0023, 4}, {0x0190, 8}};
+	device_status_t rc = device_checkpoint_verify (abstract, areas, 2);
+	if (rc != DEVICE_STATUS_SUCCESS)
+		return rc;
+
 	return device_dump_read (abstract, dc_buffer_get_data (buffer),
 		dc_buffer_get_size (buffer), SZ_PACKET);
 }
 
 
+static int
+suunto_common2_check_window (const unsigned char previous[], const unsigned char data[])
+{
+	unsigned int last_old  = array_uint16_le (previous + 0x0190);
+	unsigned int count_old = array_uint16_le (previous + 0x0192);
+	unsigned int eop_old   = array_uint16_le (previous + 0x0194);
+	unsigned int last_new  = array_uint16_le (data + 0x0190);
+	unsigned int count_new = array_uint16_le (data + 0x0192);
+	unsigned int eop_new   = array_uint16_le (data + 0x0194);
+	if (count_old == 0 ||
+		last_old < RB_PROFILE_BEGIN || last_old >= RB_PROFILE_END ||
+		last_new < RB_PROFILE_BEGIN || last_new >= RB_PROFILE_END)
+		return 0;
+
+	unsigned int window = RB_PROFILE_DISTANCE (eop_old, eop_new, 0);
+
+	// The most recent dive of the previous image must still be present.
+	if (RB_PROFILE_DISTANCE (last_old, eop_old, 0) + window >= RB_PROFILE_END - RB_PROFILE_BEGIN)
+		return 0;
+
+	// Follow the chain of new dives back to the most recent dive of the
+	// previous image. All of them must start between both end pointers,
+	// and the dive count must agree with the number of new dives.
+	unsigned int ndives = 0;
+	unsigned int next = eop_new;
+	unsigned int current = last_new;
+	while (current != last_old) {
+		if (ndives >= count_new ||
+			RB_PROFILE_DISTANCE (eop_old, current, 0) >= window ||
+			current + 4 > SZ_MEMORY ||
+			array_uint16_le (data + current + 2) != next)
+			return 0;
+
+		next = current;
+		current = array_uint16_le (data + current);
+		ndives++;
+	}
+
+	if (count_new < ndives + 1 || count_new > count_old + ndives)
+		return 0;
+
+	return 1;
+}
+
+
+device_status_t
+suunto_common2_device_dump_delta (device_t *abstract, const unsigned char previous[], unsigned int size, dc_buffer_t *buffer)
+{
+	if (size != SZ_MEMORY)
+		return suunto_common2_device_dump (abstract, buffer);
+
+	// Start from a copy of the previous memory image.
+	if (!dc_buffer_clear (buffer) || !dc_buffer_append (buffer, previous, size)) {
+		WARNING ("Insufficient buffer space available.");
+		return DEVICE_STATUS_MEMORY;
+	}
+
+	unsigned char *data = dc_buffer_get_data (buffer);
+
+	// Enable progress notifications.
+	device_progress_t progress = DEVICE_PROGRESS_INITIALIZER;
+	device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
+
+	// Pages restored from a checkpoint are only valid as long as
+	// the serial number and the ringbuffer pointers remain unchanged.
+	device_range_t areas[2] = {{0x0023, 4}, {0x0190, 8}};
+	device_status_t rc = device_checkpoint_verify (abstract, areas, 2);
+	if (rc != DEVICE_STATUS_SUCCESS)
+		return rc;
+
+	// Read the memory header, which contains the serial
+	// number and the ringbuffer pointers.
+	device_range_t ranges[3] = {{0, RB_PROFILE_BEGIN}};
+	rc = device_dump_ranges (abstract, data, ranges, 1, SZ_PACKET, &progress);
+	if (rc != DEVICE_STATUS_SUCCESS) {
+		WARNING ("Cannot read memory header.");
+		return rc;
+	}
+
+	// Obtain the end of profile pointers.
+	unsigned int eop_old = array_uint16_le (previous + 0x0194);
+	unsigned int eop_new = array_uint16_le (data + 0x0194);
+
+	// The entire profile ringbuffer is downloaded again for a different
+	// device, for invalid pointers, or when the header has changed without
+	// the end pointer moving (e.g. the ringbuffer was overwritten entirely).
+	// Otherwise only the area between both end pointers has changed, with
+	// a safety margin on both sides for the end of profile markers.
+	unsigned int n = 0;
+	if (memcmp (previous + 0x0023, data + 0x0023, 4) == 0 &&
+		eop_old >= RB_PROFILE_BEGIN && eop_old < RB_PROFILE_END &&
+		eop_new >= RB_PROFILE_BEGIN && eop_new < RB_PROFILE_END &&
+		(eop_old != eop_new || memcmp (previous + 0x0190, data + 0x0190, 8) == 0))
+	{
+		unsigned int first = ringbuffer_decrement (eop_old, SZ_PACKET, RB_PROFILE_BEGIN, RB_PROFILE_END);
+		unsigned int last  = ringbuffer_increment (eop_new, SZ_MINIMUM, RB_PROFILE_BEGIN, RB_PROFILE_END);
+		n += device_range_ringbuffer (ranges + n, first, last, RB_PROFILE_BEGIN, RB_PROFILE_END);
+		ranges[n].address = RB_PROFILE_END;
+		ranges[n].size = SZ_MEMORY - (RB_PROFILE_END);
+		n++;
+
+		rc = device_dump_ranges (abstract, data, ranges, n, SZ_PACKET, &progress);
+		if (rc != DEVICE_STATUS_SUCCESS)
+			return rc;
+
+		// The new dives must account for all the changes in the header.
+		// If not, more than one full ringbuffer has been written since
+		// the previous image, and the short range is not sufficient.
+		if (suunto_common2_check_window (previous, data))
+			return DEVICE_STATUS_SUCCESS;
+
+		n = 0;
+	}
+
+	ranges[n].address = RB_PROFILE_BEGIN;
+	ranges[n].size = SZ_MEMORY - RB_PROFILE_BEGIN;
+	n++;
+
+	return device_dump_ranges (abstract, data, ranges, n, SZ_PACKET, &progress);
+}
+
+
 device_status_t
 suunto_common2_device_foreach (device_t *abstract, dive_callback_t callback, void *userdata)
 {
@@ -232,9 +374,18 @@ suunto_common2_device_foreach (device_t *abstract, dive_callback_t callback, voi
 	progress.maximum = RB_PROFILE_END - RB_PROFILE_BEGIN + 8 + SZ_VERSION + (SZ_MINIMUM > 4 ? SZ_MINIMUM : 4);
 	device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
 
+	// Pages restored from a checkpoint are only valid as long as
+	// the serial number and the ringbuffer pointers remain unchanged.
+	device_range_t areas[2] = {{0x0023, 4}, {0x0190, 8}};
+	device_status_t rc = device_checkpoint_verify (abstract, areas, 2);
+	if (rc != DEVICE_STATUS_SUCCESS) {
+		WARNING ("Cannot verify the checkpoint.");
+		return rc;
+	}
+
 	// Read the version info.
 	unsigned char version[SZ_VERSION] = {0};
-	device_status_t rc = suunto_common2_device_version (abstract, version, sizeof (version));
+	rc = suunto_common2_device_version (abstract, version, sizeof (version));
 	if (rc != DEVICE_STATUS_SUCCESS) {
 		WARNING ("Cannot read memory header.");
 		return rc;
@@ -246,7 +397,7 @@ suunto_common2_device_foreach (device_t *abstract, dive_callback_t callback, voi
 
 	// Read the serial number.
 	unsigned char serial[SZ_MINIMUM > 4 ? SZ_MINIMUM : 4] = {0};
-	rc = suunto_common2_device_read (abstract, 0x0023, serial, sizeof (serial));
+	rc = device_read (abstract, 0x0023, serial, sizeof (serial));
 	if (rc != DEVICE_STATUS_SUCCESS) {
 		WARNING ("Cannot read memory header.");
 		return rc;
@@ -265,7 +416,7 @@ suunto_common2_device_foreach (device_t *abstract, dive_callback_t callback, voi
 
 	// Read the header bytes.
 	unsigned char header[8] = {0};
-	rc = suunto_common2_device_read (abstract, 0x0190, header, sizeof (header));
+	rc = device_read (abstract, 0x0190, header, sizeof (header));
 	if (rc != DEVICE_STATUS_SUCCESS) {
 		WARNING ("Cannot read memory header.");
 		return rc;
@@ -279,7 +430,9 @@ suunto_common2_device_foreach (device_t *abstract, dive_callback_t callback, voi
 
 	// Memory buffer to store all the dives.
 
-	unsigned char data[SZ_MINIMUM + RB_PROFILE_END - RB_PROFILE_BEGIN] = {0};
+	unsigned char *data = device_get_scratch (abstract, RB_PROFILE_END - RB_PROFILE_BEGIN);
+	if (data == NULL)
+		return DEVICE_STATUS_MEMORY;
 
 	// Calculate the total amount of bytes.
 
@@ -291,85 +444,51 @@ suunto_common2_device_foreach (device_t *abstract, dive_callback_t callback, voi
 	progress.current += sizeof (header);
 	device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
 
-	// To reduce the number of read operations, we always try to read
-	// packages with the largest possible size. As a consequence, the
-	// last package of a dive can contain data from more than one dive.
-	// Therefore, the remaining data of this package (and its size)
-	// needs to be preserved for the next dive.
-
-	unsigned int available = 0;
+	// Create the ringbuffer stream. Reading fewer than the minimum
+	// amount of bytes is unreliable, so short packets are padded.
+	rbstream_t *rbstream = NULL;
+	rc = rbstream_new (&rbstream, abstract, 1, SZ_PACKET, SZ_MINIMUM, RB_PROFILE_BEGIN, RB_PROFILE_END, end, remaining);
+	if (rc != DEVICE_STATUS_SUCCESS) {
+		WARNING ("Failed to create the ringbuffer stream.");
+		return rc;
+	}
 
 	// The ring buffer is traversed backwards to retrieve the most recent
 	// dives first. This allows us to download only the new dives.
 
 	unsigned int current = last;
 	unsigned int previous = end;
-	unsigned int address = previous;
-	unsigned int offset = remaining + SZ_MINIMUM;
+	unsigned int offset = remaining;
 	while (remaining) {
 		// Calculate the size of the current dive.
 		unsigned int size = RB_PROFILE_DISTANCE (current, previous, 1);
 		if (size < 4 || size > remaining) {
 			WARNING ("Unexpected profile size.");
+			rbstream_free (rbstream);
 			return DEVICE_STATUS_ERROR;
 		}
 
-		unsigned int nbytes = available;
-		while (nbytes < size) {
-			// Handle the ringbuffer wrap point.
-			if (address == RB_PROFILE_BEGIN)
-				address = RB_PROFILE_END;
-
-			// Calculate the package size. Try with the largest possible
-			// size first, and adjust when the end of the ringbuffer or
-			// the end of the profile data is reached.
-			unsigned int len = SZ_PACKET;
-			if (RB_PROFILE_BEGIN + len > address)
-				len = address - RB_PROFILE_BEGIN; // End of ringbuffer.
-			if (nbytes + len > remaining)
-				len = remaining - nbytes; // End of profile.
-			/*if (nbytes + len > size)
-				len = size - nbytes;*/ // End of dive (for testing only).
-
-			// Move to the begin of the current package.
-			offset -= len;
-			address -= len;
-
-			// Always read at least the minimum amount of bytes, because
-			// reading fewer bytes is unreliable. The memory buffer is
-			// large enough to prevent buffer overflows, and the extra
-			// bytes are automatically ignored (due to reading backwards).
-			unsigned int extra = 0;
-			if (len < SZ_MINIMUM)
-				extra = SZ_MINIMUM - len;
-
-			// Read the package.
-			rc = suunto_common2_device_read (abstract, address - extra, data + offset - extra, len + extra);
-			if (rc != DEVICE_STATUS_SUCCESS) {
-				WARNING ("Cannot read memory.");
-				return rc;
-			}
-
-			// Update and emit a progress event.
-			progress.current += len;
-			device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
-
-			// Next package.
-			nbytes += len;
+		// Move to the begin of the current dive.
+		offset -= size;
+
+		rc = rbstream_read (rbstream, &progress, data + offset, size);
+		if (rc != DEVICE_STATUS_SUCCESS) {
+			WARNING ("Cannot read memory.");
+			rbstream_free (rbstream);
+			return rc;
 		}
 
-		// The last package of the current dive contains the previous and
-		// next pointers (in a continuous memory area). It can also contain
-		// a number of bytes from the next dive.
+		// The start of the current dive contains the previous and
+		// next pointers (in a continuous memory area).
 
 		remaining -= size;
-		available = nbytes - size;
 
-		unsigned char *p = data + offset + available;
+		unsigned char *p = data + offset;
 		unsigned int prev = array_uint16_le (p + 0);
 		unsigned int next = array_uint16_le (p + 2);
 		if (next != previous) {
 			WARNING ("Profiles are not continuous.");
+			rbstream_free (rbstream);
 			return DEVICE_STATUS_ERROR;
 		}
 
@@ -382,11 +501,13 @@ suunto_common2_device_foreach (device_t *abstract, dive_callback_t callback, voi
 			fp_offset += 6; // HelO2
 
 		if (memcmp (p + fp_offset, device->fingerprint, sizeof (device->fingerprint)) == 0)
-			return DEVICE_STATUS_SUCCESS;
+			break;
 
 		if (callback && !callback (p + 4, size - 4, p + fp_offset, sizeof (device->fingerprint), userdata))
-			return DEVICE_STATUS_SUCCESS;
+			break;
 	}
 
+	rbstream_free (rbstream);
+
 	return DEVICE_STATUS_SUCCESS;
 }
@@ -56,12 +56,21 @@ suunto_common2_device_write (device_t *device, unsigned int address, const unsig
 device_status_t
 suunto_common2_device_dump (device_t *device, dc_buffer_t *buffer);
 
+device_status_t
+suunto_common2_device_dump_delta (device_t *device, const unsigned char previous[], unsigned int size, dc_buffer_t *buffer);
+
 device_status_t
 suunto_common2_device_foreach (device_t *device, dive_callback_t callback, void *userdata);
 
 device_status_t
 suunto_common2_device_reset_maxdepth (device_t *device);
 
+device_status_t
+suunto_d9_device_open_timeout (device_t **device, const char* name, unsigned int timeout);
+
+device_status_t
+suunto_vyper2_device_open_timeout (device_t **device, const char* name, unsigned int timeout);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
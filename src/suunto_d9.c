@@ -38,10 +38,12 @@
 typedef struct suunto_d9_device_t {
 	suunto_common2_device_t base;
 	struct serial *port;
+	unsigned int halfduplex;
 } suunto_d9_device_t;
 
 static device_status_t suunto_d9_device_packet (device_t *abstract, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize, unsigned int size);
 static device_status_t suunto_d9_device_close (device_t *abstract);
+static device_status_t suunto_d9_device_probe_halfduplex (suunto_d9_device_t *device, unsigned int timeout);
 
 static const suunto_common2_device_backend_t suunto_d9_device_backend = {
 	{
@@ -51,6 +53,8 @@ static const suunto_common2_device_backend_t suunto_d9_device_backend = {
 		suunto_common2_device_read, /* read */
 		suunto_common2_device_write, /* write */
 		suunto_common2_device_dump, /* dump */
+		NULL, /* dump_to */
+		suunto_common2_device_dump_delta, /* dump_delta */
 		suunto_common2_device_foreach, /* foreach */
 		suunto_d9_device_close /* close */
 	},
@@ -69,6 +73,13 @@ device_is_suunto_d9 (device_t *abstract)
 
 device_status_t
 suunto_d9_device_open (device_t **out, const char* name)
+{
+	return suunto_d9_device_open_timeout (out, name, 0);
+}
+
+
+device_status_t
+suunto_d9_device_open_timeout (device_t **out, const char* name, unsigned int timeout)
 {
 	if (out == NULL)
 		return DEVICE_STATUS_ERROR;
@@ -85,6 +96,7 @@ suunto_d9_device_open (device_t **out, const char* name)
 
 	// Set the default values.
 	device->port = NULL;
+	device->halfduplex = 1;
 
 	// Open the device.
 	int rc = serial_open (&device->port, name);
@@ -94,6 +106,9 @@ suunto_d9_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
+	// Record the traffic in the trace buffer.
+	serial_set_trace (device->port, device_get_trace ((device_t *) device));
+
 	// Set the serial communication protocol (9600 8N1).
 	rc = serial_configure (device->port, 9600, 8, SERIAL_PARITY_NONE, 1, SERIAL_FLOWCONTROL_NONE);
 	if (rc == -1) {
@@ -103,8 +118,9 @@ suunto_d9_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
-	// Set the timeout for receiving data (3000 ms).
-	if (serial_set_timeout (device->port, 3000) == -1) {
+	// Set the timeout for receiving data (3000 ms), or the
+	// shorter timeout that was requested to identify the device.
+	if (serial_set_timeout (device->port, timeout ? timeout : 3000) == -1) {
 		WARNING ("Failed to set the timeout.");
 		serial_close (device->port);
 		free (device);
@@ -125,6 +141,23 @@ suunto_d9_device_open (device_t **out, const char* name)
 	// Make sure everything is in a sane state.
 	serial_flush (device->port, SERIAL_QUEUE_BOTH);
 
+	// Detect whether the interface requires the RTS line.
+	device_status_t status = suunto_d9_device_probe_halfduplex (device, timeout);
+
+	// To identify the device, the version command has to succeed, either
+	// without the RTS switching, or with the RTS switching as a fallback.
+	if (timeout && status != DEVICE_STATUS_SUCCESS) {
+		unsigned char version[SUUNTO_D9_VERSION_SIZE] = {0};
+		serial_set_timeout (device->port, timeout);
+		status = suunto_common2_device_version ((device_t *) device, version, sizeof (version));
+		serial_set_timeout (device->port, 3000);
+		if (status != DEVICE_STATUS_SUCCESS) {
+			serial_close (device->port);
+			free (device);
+			return status;
+		}
+	}
+
 	*out = (device_t*) device;
 
 	return DEVICE_STATUS_SUCCESS;
@@ -161,7 +194,8 @@ suunto_d9_device_packet (device_t *abstract, const unsigned char command[], unsi
 		return DEVICE_STATUS_CANCELLED;
 
 	// Clear RTS to send the command.
-	serial_set_rts (device->port, 0);
+	if (device->halfduplex)
+		serial_set_rts (device->port, 0);
 
 	// Send the command to the dive computer.
 	int n = serial_write (device->port, command, csize);
@@ -170,8 +204,11 @@ suunto_d9_device_packet (device_t *abstract, const unsigned char command[], unsi
 		return EXITCODE (n);
 	}
 
-	// Wait until all data has been transmitted.
-	serial_drain (device->port);
+	// Wait until all data has been transmitted. Without RTS
+	// switching, the echo and the answer are received directly
+	// after each other, without waiting for the transmission.
+	if (device->halfduplex)
+		serial_drain (device->port);
 
 	// Receive the echo.
 	unsigned char echo[128] = {0};
@@ -189,7 +226,8 @@ suunto_d9_device_packet (device_t *abstract, const unsigned char command[], unsi
 	}
 
 	// Set RTS to receive the reply.
-	serial_set_rts (device->port, 1);
+	if (device->halfduplex)
+		serial_set_rts (device->port, 1);
 
 	// Receive the answer of the dive computer.
 	n = serial_read (device->port, answer, asize);
@@ -221,6 +259,7 @@ suunto_d9_device_packet (device_t *abstract, const unsigned char command[], unsi
 	unsigned char ccrc = checksum_xor_uint8 (answer, asize - 1, 0x00);
 	if (crc != ccrc) {
 		WARNING ("Unexpected answer CRC.");
+		device_stats_crc (abstract);
 		return DEVICE_STATUS_PROTOCOL;
 	}
 
@@ -228,6 +267,36 @@ suunto_d9_device_packet (device_t *abstract, const unsigned char command[], unsi
 }
 
 
+static device_status_t
+suunto_d9_device_probe_halfduplex (suunto_d9_device_t *device, unsigned int timeout)
+{
+	device_t *abstract = (device_t *) device;
+
+	// Many (USB) interfaces switch between transmitting and receiving
+	// automatically. For those interfaces, the RTS line can be left in
+	// the transmit state, and the echo and the answer arrive in a single
+	// receive window. Send the version command once, without retries and
+	// with a shorter timeout, to find out whether the interface needs
+	// the RTS switching. If not, fall back to the original sequence.
+	device->halfduplex = 0;
+	serial_set_rts (device->port, 0);
+	serial_set_timeout (device->port, (timeout && timeout < 1000) ? timeout : 1000);
+
+	unsigned char answer[4 + 4] = {0};
+	unsigned char command[4] = {0x0F, 0x00, 0x00, 0x0F};
+	device_status_t rc = suunto_d9_device_packet (abstract, command, sizeof (command), answer, sizeof (answer), 4);
+	if (rc != DEVICE_STATUS_SUCCESS) {
+		device->halfduplex = 1;
+		serial_sleep (100);
+		serial_flush (device->port, SERIAL_QUEUE_BOTH);
+	}
+
+	serial_set_timeout (device->port, 3000);
+
+	return rc;
+}
+
+
 device_status_t
 suunto_d9_device_reset_maxdepth (device_t *abstract)
 {
@@ -178,6 +178,10 @@ suunto_d9_parser_samples_foreach (parser_t *abstract, sample_callback_t callback
 	// Offset to the first marker position.
 	unsigned int marker = array_uint16_le (data + profile + 3);
 
+	// The events are only decoded when requested, but
+	// they still have to be walked to find the next sample.
+	int events = SAMPLE_ENABLED (abstract, SAMPLE_TYPE_EVENT);
+
 	unsigned int time = 0;
 	unsigned int nsamples = 0;
 	unsigned int offset = profile + 5;
@@ -244,6 +248,10 @@ suunto_d9_parser_samples_foreach (parser_t *abstract, sample_callback_t callback
 					break;
 				case 0x03: // Event
 					assert (offset + 2 <= size);
+					if (!events) {
+						offset += 2;
+						break;
+					}
 					type    = data[offset + 0];
 					seconds = data[offset + 1];
 					switch (type & 0x7F) {
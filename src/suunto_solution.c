@@ -53,6 +53,8 @@ static const device_backend_t suunto_solution_device_backend = {
 	NULL, /* read */
 	NULL, /* write */
 	suunto_solution_device_dump, /* dump */
+	NULL, /* dump_to */
+	NULL, /* dump_delta */
 	suunto_solution_device_foreach, /* foreach */
 	suunto_solution_device_close /* close */
 };
@@ -94,6 +96,9 @@ suunto_solution_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
+	// Record the traffic in the trace buffer.
+	serial_set_trace (device->port, device_get_trace ((device_t *) device));
+
 	// Set the serial communication protocol (1200 8N2).
 	rc = serial_configure (device->port, 1200, 8, SERIAL_PARITY_NONE, 2, SERIAL_FLOWCONTROL_NONE);
 	if (rc == -1) {
@@ -29,6 +29,7 @@
 #include "serial.h"
 #include "checksum.h"
 #include "array.h"
+#include "ringbuffer.h"
 #include "utils.h"
 
 #define EXITCODE(rc) \
@@ -53,6 +54,7 @@ typedef struct suunto_vyper_device_t {
 static device_status_t suunto_vyper_device_read (device_t *abstract, unsigned int address, unsigned char data[], unsigned int size);
 static device_status_t suunto_vyper_device_write (device_t *abstract, unsigned int address, const unsigned char data[], unsigned int size);
 static device_status_t suunto_vyper_device_dump (device_t *abstract, dc_buffer_t *buffer);
+static device_status_t suunto_vyper_device_dump_delta (device_t *abstract, const unsigned char previous[], unsigned int size, dc_buffer_t *buffer);
 static device_status_t suunto_vyper_device_foreach (device_t *abstract, dive_callback_t callback, void *userdata);
 static device_status_t suunto_vyper_device_close (device_t *abstract);
 
@@ -63,6 +65,8 @@ static const device_backend_t suunto_vyper_device_backend = {
 	suunto_vyper_device_read, /* read */
 	suunto_vyper_device_write, /* write */
 	suunto_vyper_device_dump, /* dump */
+	NULL, /* dump_to */
+	suunto_vyper_device_dump_delta, /* dump_delta */
 	suunto_vyper_device_foreach, /* foreach */
 	suunto_vyper_device_close /* close */
 };
@@ -109,6 +113,8 @@ suunto_vyper_device_open (device_t **out, const char* name)
 
 	// Initialize the base class.
 	suunto_common_device_init (&device->base, &suunto_vyper_device_backend);
+	device_set_memory ((device_t *) device, SUUNTO_VYPER_MEMORY_SIZE, 1);
+	device_allow_checkpoint ((device_t *) device);
 
 	// Set the default values.
 	device->port = NULL;
@@ -122,6 +128,9 @@ suunto_vyper_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
+	// Record the traffic in the trace buffer.
+	serial_set_trace (device->port, device_get_trace ((device_t *) device));
+
 	// Set the serial communication protocol (2400 8O1).
 	rc = serial_configure (device->port, 2400, 8, SERIAL_PARITY_ODD, 1, SERIAL_FLOWCONTROL_NONE);
 	if (rc == -1) {
@@ -501,11 +510,105 @@ suunto_vyper_device_dump (device_t *abstract, dc_buffer_t *buffer)
 		return DEVICE_STATUS_MEMORY;
 	}
 
+	// Pages restored from a checkpoint are only valid as long as the
+	// memory header (with the device info and the pointers) remains
+	// unchanged. The Vyper header always contains the Spyder header.
+	device_range_t areas[1] = {{0, suunto_vyper_layout.rb_profile_begin}};
+	device_status_t rc = device_checkpoint_verify (abstract, areas, 1);
+	if (rc != DEVICE_STATUS_SUCCESS)
+		return rc;
+
 	return device_dump_read (abstract, dc_buffer_get_data (buffer),
 		dc_buffer_get_size (buffer), SUUNTO_VYPER_PACKET_SIZE);
 }
 
 
+static device_status_t
+suunto_vyper_device_dump_delta (device_t *abstract, const unsigned char previous[], unsigned int size, dc_buffer_t *buffer)
+{
+	if (! device_is_suunto_vyper (abstract))
+		return DEVICE_STATUS_TYPE_MISMATCH;
+
+	if (size != SUUNTO_VYPER_MEMORY_SIZE)
+		return suunto_vyper_device_dump (abstract, buffer);
+
+	// Start from a copy of the previous memory image.
+	if (!dc_buffer_clear (buffer) || !dc_buffer_append (buffer, previous, size)) {
+		WARNING ("Insufficient buffer space available.");
+		return DEVICE_STATUS_MEMORY;
+	}
+
+	unsigned char *data = dc_buffer_get_data (buffer);
+
+	// Enable progress notifications.
+	device_progress_t progress = DEVICE_PROGRESS_INITIALIZER;
+	device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
+
+	// Pages restored from a checkpoint are only valid as long
+	// as the memory header remains unchanged.
+	device_range_t areas[1] = {{0, suunto_vyper_layout.rb_profile_begin}};
+	device_status_t rc = device_checkpoint_verify (abstract, areas, 1);
+	if (rc != DEVICE_STATUS_SUCCESS)
+		return rc;
+
+	// Read the memory header. Its size depends on the model, but the
+	// larger Vyper header always contains the Spyder header too.
+	device_range_t ranges[2] = {{0, suunto_vyper_layout.rb_profile_begin}};
+	rc = device_dump_ranges (abstract, data, ranges, 1, SUUNTO_VYPER_PACKET_SIZE, &progress);
+	if (rc != DEVICE_STATUS_SUCCESS)
+		return rc;
+
+	// Identify the connected device as a Vyper or a Spyder.
+	unsigned int hoffset = HDR_DEVINFO_VYPER;
+	const suunto_common_layout_t *layout = &suunto_vyper_layout;
+	if (data[HDR_DEVINFO_VYPER] == 20 || data[HDR_DEVINFO_VYPER] == 30 || data[HDR_DEVINFO_VYPER] == 60) {
+		hoffset = HDR_DEVINFO_SPYDER;
+		layout = &suunto_spyder_layout;
+	}
+
+	// Get the end of profile pointers.
+	unsigned int eop_old = array_uint16_be (previous + layout->eop);
+	unsigned int eop_new = array_uint16_be (data + layout->eop);
+
+	// The entire profile ringbuffer is downloaded again for a different
+	// device, for invalid pointers, or when the header has changed without
+	// the end pointer moving. Otherwise only the area between both end
+	// pointers has changed, with a safety margin for the end marker.
+	unsigned int n = 0;
+	if (memcmp (previous + hoffset, data + hoffset, 6) == 0 &&
+		eop_old >= layout->rb_profile_begin && eop_old < layout->rb_profile_end &&
+		eop_new >= layout->rb_profile_begin && eop_new < layout->rb_profile_end &&
+		(eop_old != eop_new || memcmp (previous, data, layout->rb_profile_begin) == 0))
+	{
+		unsigned int first = ringbuffer_decrement (eop_old, SUUNTO_VYPER_PACKET_SIZE, layout->rb_profile_begin, layout->rb_profile_end);
+		unsigned int end   = ringbuffer_increment (eop_new, 1, layout->rb_profile_begin, layout->rb_profile_end);
+		n += device_range_ringbuffer (ranges + n, first, end, layout->rb_profile_begin, layout->rb_profile_end);
+
+		rc = device_dump_ranges (abstract, data, ranges, n, SUUNTO_VYPER_PACKET_SIZE, &progress);
+		if (rc != DEVICE_STATUS_SUCCESS)
+			return rc;
+
+		// The header has no dive count, so the amount of new data is
+		// bounded with the safety margin instead. It contains the end
+		// of the most recent dive of the previous image, and changes
+		// once more than one full ringbuffer has been written.
+		unsigned int address = first;
+		while (address != eop_old && previous[address] == data[address])
+			address = ringbuffer_increment (address, 1, layout->rb_profile_begin, layout->rb_profile_end);
+		if (address == eop_old)
+			return DEVICE_STATUS_SUCCESS;
+
+		n = 0;
+	}
+
+	ranges[n].address = layout->rb_profile_begin;
+	ranges[n].size = layout->rb_profile_end - layout->rb_profile_begin;
+	n++;
+
+	return device_dump_ranges (abstract, data, ranges, n, SUUNTO_VYPER_PACKET_SIZE, &progress);
+}
+
+
 static device_status_t
 suunto_vyper_device_foreach (device_t *abstract, dive_callback_t callback, void *userdata)
 {
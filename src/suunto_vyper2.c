@@ -51,6 +51,8 @@ static const suunto_common2_device_backend_t suunto_vyper2_device_backend = {
 		suunto_common2_device_read, /* read */
 		suunto_common2_device_write, /* write */
 		suunto_common2_device_dump, /* dump */
+		NULL, /* dump_to */
+		suunto_common2_device_dump_delta, /* dump_delta */
 		suunto_common2_device_foreach, /* foreach */
 		suunto_vyper2_device_close /* close */
 	},
@@ -69,6 +71,13 @@ device_is_suunto_vyper2 (device_t *abstract)
 
 device_status_t
 suunto_vyper2_device_open (device_t **out, const char* name)
+{
+	return suunto_vyper2_device_open_timeout (out, name, 0);
+}
+
+
+device_status_t
+suunto_vyper2_device_open_timeout (device_t **out, const char* name, unsigned int timeout)
 {
 	if (out == NULL)
 		return DEVICE_STATUS_ERROR;
@@ -94,6 +103,9 @@ suunto_vyper2_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
+	// Record the traffic in the trace buffer.
+	serial_set_trace (device->port, device_get_trace ((device_t *) device));
+
 	// Set the serial communication protocol (9600 8N1).
 	rc = serial_configure (device->port, 9600, 8, SERIAL_PARITY_NONE, 1, SERIAL_FLOWCONTROL_NONE);
 	if (rc == -1) {
@@ -103,8 +115,9 @@ suunto_vyper2_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
-	// Set the timeout for receiving data (3000 ms).
-	if (serial_set_timeout (device->port, 3000) == -1) {
+	// Set the timeout for receiving data (3000 ms), or the
+	// shorter timeout that was requested to identify the device.
+	if (serial_set_timeout (device->port, timeout ? timeout : 3000) == -1) {
 		WARNING ("Failed to set the timeout.");
 		serial_close (device->port);
 		free (device);
@@ -125,6 +138,25 @@ suunto_vyper2_device_open (device_t **out, const char* name)
 	// Make sure everything is in a sane state.
 	serial_flush (device->port, SERIAL_QUEUE_BOTH);
 
+	// Identify the device with the version command, and
+	// restore the normal timeout afterwards.
+	if (timeout) {
+		unsigned char version[SUUNTO_VYPER2_VERSION_SIZE] = {0};
+		device_status_t status = suunto_common2_device_version ((device_t *) device, version, sizeof (version));
+		if (status != DEVICE_STATUS_SUCCESS) {
+			serial_close (device->port);
+			free (device);
+			return status;
+		}
+
+		if (serial_set_timeout (device->port, 3000) == -1) {
+			WARNING ("Failed to set the timeout.");
+			serial_close (device->port);
+			free (device);
+			return DEVICE_STATUS_IO;
+		}
+	}
+
 	*out = (device_t*) device;
 
 	return DEVICE_STATUS_SUCCESS;
@@ -210,6 +242,7 @@ suunto_vyper2_device_packet (device_t *abstract, const unsigned char command[],
 	unsigned char ccrc = checksum_xor_uint8 (answer, asize - 1, 0x00);
 	if (crc != ccrc) {
 		WARNING ("Unexpected answer CRC.");
+		device_stats_crc (abstract);
 		return DEVICE_STATUS_PROTOCOL;
 	}
 
@@ -0,0 +1,194 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2009 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <sys/time.h>
+#endif
+
+#include <stdlib.h> // malloc, free
+#include <string.h> // memcpy
+
+#include "trace.h"
+
+//
+// The trace buffer is a ringbuffer with variable sized frames. Each
+// frame consists of an 8 byte header, followed by the data bytes. The
+// header contains a monotonic timestamp in milliseconds (4 bytes), the
+// number of data bytes (2 bytes), the direction (1 byte) and a reserved
+// byte, all in little endian byte order. When the buffer is full, the
+// oldest frames are discarded to make room for the new frame. The
+// number of transferred bytes is counted, even without a buffer.
+//
+
+unsigned int
+trace_now (void)
+{
+#ifdef _WIN32
+	return GetTickCount ();
+#elif defined (CLOCK_MONOTONIC)
+	struct timespec ts;
+	if (clock_gettime (CLOCK_MONOTONIC, &ts) != 0)
+		return 0;
+
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#else
+	struct timeval tv;
+	if (gettimeofday (&tv, NULL) != 0)
+		return 0;
+
+	return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+#endif
+}
+
+
+static void
+trace_write (trace_t *trace, unsigned int offset, const unsigned char data[], unsigned int size)
+{
+	offset %= trace->size;
+
+	unsigned int len = trace->size - offset;
+	if (len > size)
+		len = size;
+
+	memcpy (trace->data + offset, data, len);
+	memcpy (trace->data, data + len, size - len);
+}
+
+
+static void
+trace_copy (const trace_t *trace, unsigned int offset, unsigned char data[], unsigned int size)
+{
+	offset %= trace->size;
+
+	unsigned int len = trace->size - offset;
+	if (len > size)
+		len = size;
+
+	memcpy (data, trace->data + offset, len);
+	memcpy (data + len, trace->data, size - len);
+}
+
+
+void
+trace_init (trace_t *trace)
+{
+	trace->data = NULL;
+	trace->size = 0;
+	trace->head = 0;
+	trace->length = 0;
+	trace->nread = 0;
+	trace->nwritten = 0;
+}
+
+
+int
+trace_resize (trace_t *trace, unsigned int size)
+{
+	// Discard the existing frames.
+	free (trace->data);
+	trace->data = NULL;
+	trace->size = 0;
+	trace->head = 0;
+	trace->length = 0;
+
+	if (size == 0)
+		return 0;
+
+	if (size <= TRACE_HEADER_SIZE)
+		return -1;
+
+	trace->data = (unsigned char *) malloc (size);
+	if (trace->data == NULL)
+		return -1;
+
+	trace->size = size;
+
+	return 0;
+}
+
+
+void
+trace_append (trace_t *trace, trace_direction_t direction, const void *data, unsigned int size)
+{
+	if (trace == NULL)
+		return;
+
+	// Update the byte counters.
+	if (direction == TRACE_DIRECTION_READ)
+		trace->nread += size;
+	else
+		trace->nwritten += size;
+
+	if (trace->data == NULL || size == 0)
+		return;
+
+	// Truncate frames that do not fit into the buffer.
+	if (size > 0xFFFF)
+		size = 0xFFFF;
+	if (size > trace->size - TRACE_HEADER_SIZE)
+		size = trace->size - TRACE_HEADER_SIZE;
+
+	// Discard the oldest frames until the new frame fits.
+	while (trace->length + TRACE_HEADER_SIZE + size > trace->size) {
+		unsigned char header[TRACE_HEADER_SIZE];
+		trace_copy (trace, trace->head, header, sizeof (header));
+		unsigned int len = TRACE_HEADER_SIZE + header[4] + (header[5] << 8);
+		trace->head = (trace->head + len) % trace->size;
+		trace->length -= len;
+	}
+
+	unsigned int timestamp = trace_now ();
+	unsigned char header[TRACE_HEADER_SIZE] = {
+		(timestamp      ) & 0xFF,
+		(timestamp >>  8) & 0xFF,
+		(timestamp >> 16) & 0xFF,
+		(timestamp >> 24) & 0xFF,
+		(size      ) & 0xFF,
+		(size >>  8) & 0xFF,
+		direction,
+		0x00};
+
+	unsigned int offset = trace->head + trace->length;
+	trace_write (trace, offset, header, sizeof (header));
+	trace_write (trace, offset + TRACE_HEADER_SIZE, (const unsigned char *) data, size);
+
+	trace->length += TRACE_HEADER_SIZE + size;
+}
+
+
+unsigned int
+trace_read (const trace_t *trace, unsigned char data[], unsigned int size)
+{
+	if (trace == NULL || trace->data == NULL)
+		return 0;
+
+	// Copy the frames in chronological order.
+	if (size > trace->length)
+		size = trace->length;
+
+	trace_copy (trace, trace->head, data, size);
+
+	return size;
+}
@@ -0,0 +1,64 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2009 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define TRACE_HEADER_SIZE 8
+
+typedef enum trace_direction_t {
+	TRACE_DIRECTION_READ = 0,
+	TRACE_DIRECTION_WRITE = 1
+} trace_direction_t;
+
+typedef struct trace_t {
+	unsigned char *data;
+	unsigned int size;
+	unsigned int head;
+	unsigned int length;
+	unsigned int nread;
+	unsigned int nwritten;
+} trace_t;
+
+unsigned int
+trace_now (void);
+
+void
+trace_init (trace_t *trace);
+
+int
+trace_resize (trace_t *trace, unsigned int size);
+
+void
+trace_append (trace_t *trace, trace_direction_t direction, const void *data, unsigned int size);
+
+unsigned int
+trace_read (const trace_t *trace, unsigned char data[], unsigned int size);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* TRACE_H */
@@ -28,7 +28,6 @@
 #include "serial.h"
 #include "utils.h"
 #include "ringbuffer.h"
-#include "checksum.h"
 #include "array.h"
 
 #define EXITCODE(rc) \
@@ -49,6 +48,10 @@ typedef struct uwatec_aladin_device_t {
 	unsigned int timestamp;
 	unsigned int devtime;
 	dc_ticks_t systime;
+	// Receive state.
+	unsigned int nbytes;
+	dc_ticks_t received;
+	unsigned char packet[UWATEC_ALADIN_MEMORY_SIZE + 2];
 } uwatec_aladin_device_t ;
 
 static device_status_t uwatec_aladin_device_set_fingerprint (device_t *abstract, const unsigned char data[], unsigned int size);
@@ -63,6 +66,8 @@ static const device_backend_t uwatec_aladin_device_backend = {
 	NULL, /* read */
 	NULL, /* write */
 	uwatec_aladin_device_dump, /* dump */
+	NULL, /* dump_to */
+	NULL, /* dump_delta */
 	uwatec_aladin_device_foreach, /* foreach */
 	uwatec_aladin_device_close /* close */
 };
@@ -98,6 +103,8 @@ uwatec_aladin_device_open (device_t **out, const char* name)
 	device->timestamp = 0;
 	device->systime = (dc_ticks_t) -1;
 	device->devtime = 0;
+	device->nbytes = 0;
+	device->received = (dc_ticks_t) -1;
 
 	// Open the device.
 	int rc = serial_open (&device->port, name);
@@ -107,6 +114,9 @@ uwatec_aladin_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
+	// Record the traffic in the trace buffer.
+	serial_set_trace (device->port, device_get_trace ((device_t *) device));
+
 	// Set the serial communication protocol (19200 8N1).
 	rc = serial_configure (device->port, 19200, 8, SERIAL_PARITY_NONE, 1, SERIAL_FLOWCONTROL_NONE);
 	if (rc == -1) {
@@ -194,77 +204,114 @@ uwatec_aladin_device_set_fingerprint (device_t *abstract, const unsigned char da
 }
 
 
-static device_status_t
-uwatec_aladin_device_dump (device_t *abstract, dc_buffer_t *buffer)
+static void
+uwatec_aladin_process (uwatec_aladin_device_t *device, const unsigned char data[], unsigned int size)
 {
-	uwatec_aladin_device_t *device = (uwatec_aladin_device_t*) abstract;
-
-	if (! device_is_uwatec_aladin (abstract))
-		return DEVICE_STATUS_TYPE_MISMATCH;
-
-	// Erase the current contents of the buffer and
-	// pre-allocate the required amount of memory.
-	if (!dc_buffer_clear (buffer) || !dc_buffer_reserve (buffer, UWATEC_ALADIN_MEMORY_SIZE)) {
-		WARNING ("Insufficient buffer space available.");
-		return DEVICE_STATUS_MEMORY;
+	// The data is received in place, directly after the bytes that are
+	// already stored in the package. Bytes are only ever moved towards
+	// the start of the package, so they are never overwritten before
+	// they are processed.
+	unsigned int i = 0;
+
+	// Search for the header of the package.
+	while (i < size && device->nbytes < HEADER) {
+		unsigned char value = data[i++];
+		if (value == (device->nbytes < 3 ? 0x55 : 0x00)) {
+			device->packet[device->nbytes++] = value;
+			if (device->nbytes == HEADER) {
+				// Fetch the current system time.
+				device->received = dc_datetime_now ();
+			}
+		} else {
+			// Reset, but keep the bytes that can still be
+			// the start of a new header (0x55 0x55 0x55).
+			if (value != 0x55)
+				device->nbytes = 0;
+			device_event_emit (&device->base, DEVICE_EVENT_WAITING, NULL);
+		}
 	}
 
-	// Enable progress notifications.
-	device_progress_t progress = DEVICE_PROGRESS_INITIALIZER;
-	progress.maximum = UWATEC_ALADIN_MEMORY_SIZE + 2;
-	device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
+	// Append the remaining part of the package.
+	unsigned int len = size - i;
+	if (len > sizeof (device->packet) - device->nbytes)
+		len = sizeof (device->packet) - device->nbytes;
+	memmove (device->packet + device->nbytes, data + i, len);
+	device->nbytes += len;
+}
+
 
-	unsigned char answer[UWATEC_ALADIN_MEMORY_SIZE + 2] = {0};
+static device_status_t
+uwatec_aladin_receive (uwatec_aladin_device_t *device, device_progress_t *progress, int blocking)
+{
+	device_t *abstract = (device_t *) device;
 
-	// Receive the header of the package.
-	for (unsigned int i = 0; i < 4;) {
+	while (device->nbytes < sizeof (device->packet)) {
 		if (device_is_cancelled (abstract))
 			return DEVICE_STATUS_CANCELLED;
 
-		int rc = serial_read (device->port, answer + i, 1);
-		if (rc != 1) {
+		// Get the number of bytes that have already been received. The
+		// transmission can be preceded by some garbage bytes, so we never
+		// read more than the remaining part of the package.
+		int available = serial_get_received (device->port);
+		if (available < 0) {
+			WARNING ("Failed to receive the answer.");
+			return DEVICE_STATUS_IO;
+		}
+
+		unsigned int len = available;
+		if (blocking && device->nbytes >= HEADER) {
+			len = sizeof (device->packet) - device->nbytes; // Wait for the remainder.
+		} else if (len == 0) {
+			if (!blocking)
+				break;
+			len = 1; // Wait for the next byte.
+		}
+		if (len > sizeof (device->packet) - device->nbytes)
+			len = sizeof (device->packet) - device->nbytes;
+
+		unsigned char *data = device->packet + device->nbytes;
+		int rc = serial_read (device->port, data, len);
+		if (rc != len) {
 			WARNING ("Failed to receive the answer.");
 			return EXITCODE (rc);
 		}
-		if (answer[i] == (i < 3 ? 0x55 : 0x00)) {
-			i++; // Continue.
-		} else {
-			i = 0; // Reset.
-			device_event_emit (abstract, DEVICE_EVENT_WAITING, NULL);
+
+		uwatec_aladin_process (device, data, len);
+
+		// Update and emit a progress event.
+		if (progress && device->nbytes >= HEADER) {
+			progress->current = device->nbytes;
+			device_event_emit (abstract, DEVICE_EVENT_PROGRESS, progress);
 		}
 	}
 
-	// Fetch the current system time.
-	dc_ticks_t now = dc_datetime_now ();
+	return DEVICE_STATUS_SUCCESS;
+}
 
-	// Update and emit a progress event.
-	progress.current += 4;
-	device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
 
-	// Receive the remaining part of the package.
-	int rc = serial_read (device->port, answer + 4, sizeof (answer) - 4);
-	if (rc != sizeof (answer) - 4) {
-		WARNING ("Unexpected EOF in answer.");
-		return EXITCODE (rc);
-	}
+static device_status_t
+uwatec_aladin_finish (uwatec_aladin_device_t *device, dc_buffer_t *buffer)
+{
+	device_t *abstract = (device_t *) device;
 
-	// Update and emit a progress event.
-	progress.current += sizeof (answer) - 4;
-	device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
+	unsigned char *answer = device->packet;
+
+	// Reset the receive state for the next transmission.
+	device->nbytes = 0;
 
-	// Reverse the bit order.
-	array_reverse_bits (answer, sizeof (answer));
+	// Reverse the bit order and calculate the checksum in a single pass.
+	unsigned short ccrc = array_reverse_bits_add_uint16 (answer, UWATEC_ALADIN_MEMORY_SIZE, 0x0000);
+	array_reverse_bits (answer + UWATEC_ALADIN_MEMORY_SIZE, 2);
 
 	// Verify the checksum of the package.
 	unsigned short crc = array_uint16_le (answer + UWATEC_ALADIN_MEMORY_SIZE);
-	unsigned short ccrc = checksum_add_uint16 (answer, UWATEC_ALADIN_MEMORY_SIZE, 0x0000);
 	if (ccrc != crc) {
 		WARNING ("Unexpected answer CRC.");
 		return DEVICE_STATUS_PROTOCOL;
 	}
 
 	// Store the clock calibration values.
-	device->systime = now;
+	device->systime = device->received;
 	device->devtime = array_uint32_be (answer + HEADER + 0x7f8);
 
 	// Emit a clock event.
@@ -273,12 +320,77 @@ uwatec_aladin_device_dump (device_t *abstract, dc_buffer_t *buffer)
 	clock.devtime = device->devtime;
 	device_event_emit (abstract, DEVICE_EVENT_CLOCK, &clock);
 
-	dc_buffer_append (buffer, answer, UWATEC_ALADIN_MEMORY_SIZE);
+	if (!dc_buffer_append (buffer, answer, UWATEC_ALADIN_MEMORY_SIZE)) {
+		WARNING ("Insufficient buffer space available.");
+		return DEVICE_STATUS_MEMORY;
+	}
 
 	return DEVICE_STATUS_SUCCESS;
 }
 
 
+device_status_t
+uwatec_aladin_device_poll (device_t *abstract, dc_buffer_t *buffer)
+{
+	uwatec_aladin_device_t *device = (uwatec_aladin_device_t*) abstract;
+
+	if (! device_is_uwatec_aladin (abstract))
+		return DEVICE_STATUS_TYPE_MISMATCH;
+
+	// Erase the current contents of the buffer.
+	if (!dc_buffer_clear (buffer)) {
+		WARNING ("Insufficient buffer space available.");
+		return DEVICE_STATUS_MEMORY;
+	}
+
+	// Process all the bytes that have already been received,
+	// without waiting for the remaining part of the package.
+	device_status_t rc = uwatec_aladin_receive (device, NULL, 0);
+	if (rc != DEVICE_STATUS_SUCCESS) {
+		device->nbytes = 0;
+		return rc;
+	}
+
+	// The buffer remains empty until the package is complete.
+	if (device->nbytes < sizeof (device->packet))
+		return DEVICE_STATUS_SUCCESS;
+
+	return uwatec_aladin_finish (device, buffer);
+}
+
+
+static device_status_t
+uwatec_aladin_device_dump (device_t *abstract, dc_buffer_t *buffer)
+{
+	uwatec_aladin_device_t *device = (uwatec_aladin_device_t*) abstract;
+
+	if (! device_is_uwatec_aladin (abstract))
+		return DEVICE_STATUS_TYPE_MISMATCH;
+
+	// Erase the current contents of the buffer and
+	// pre-allocate the required amount of memory.
+	if (!dc_buffer_clear (buffer) || !dc_buffer_reserve (buffer, UWATEC_ALADIN_MEMORY_SIZE)) {
+		WARNING ("Insufficient buffer space available.");
+		return DEVICE_STATUS_MEMORY;
+	}
+
+	// Enable progress notifications.
+	device_progress_t progress = DEVICE_PROGRESS_INITIALIZER;
+	progress.maximum = UWATEC_ALADIN_MEMORY_SIZE + 2;
+	device_event_emit (abstract, DEVICE_EVENT_PROGRESS, &progress);
+
+	// Receive the package. A partial package,
+	// received with polling, is resumed here.
+	device_status_t rc = uwatec_aladin_receive (device, &progress, 1);
+	if (rc != DEVICE_STATUS_SUCCESS) {
+		device->nbytes = 0;
+		return rc;
+	}
+
+	return uwatec_aladin_finish (device, buffer);
+}
+
+
 static device_status_t
 uwatec_aladin_device_foreach (device_t *abstract, dive_callback_t callback, void *userdata)
 {
@@ -352,10 +464,18 @@ uwatec_aladin_extract_dives (device_t *abstract, const unsigned char* data, unsi
 	// we move the current pointer backwards until a start marker is found.
 	unsigned int previous = eop;
 	unsigned int current = eop;
-	for (unsigned int i = 0; i < ndives; ++i) {
-		// Memory buffer to store one dive.
-		unsigned char buffer[18 + RB_PROFILE_END - RB_PROFILE_BEGIN] = {0};
 
+	// Memory buffer to store one dive. Without a device, there is
+	// no scratch memory available and the buffer is allocated here.
+	unsigned char *buffer = NULL;
+	if (abstract)
+		buffer = device_get_scratch (abstract, 18 + RB_PROFILE_END - RB_PROFILE_BEGIN);
+	else
+		buffer = (unsigned char *) malloc (18 + RB_PROFILE_END - RB_PROFILE_BEGIN);
+	if (buffer == NULL)
+		return DEVICE_STATUS_MEMORY;
+
+	for (unsigned int i = 0; i < ndives; ++i) {
 		// Get the offset to the current logbook entry.
 		unsigned int offset = ((eol + 37 - i) % 37) * 12 + RB_PROFILE_END;
 
@@ -414,11 +534,14 @@ uwatec_aladin_extract_dives (device_t *abstract, const unsigned char* data, unsi
 		// Automatically abort when a dive is older than the provided timestamp.
 		unsigned int timestamp = array_uint32_le (buffer + 11);
 		if (device && timestamp <= device->timestamp)
-			return DEVICE_STATUS_SUCCESS;
+			break;
 
 		if (callback && !callback (buffer, len + 18, buffer + 11, 4, userdata))
-			return DEVICE_STATUS_SUCCESS;
+			break;
 	}
 
+	if (abstract == NULL)
+		free (buffer);
+
 	return DEVICE_STATUS_SUCCESS;
 }
@@ -36,6 +36,9 @@ uwatec_aladin_device_open (device_t **device, const char* name);
 device_status_t
 uwatec_aladin_device_set_timestamp (device_t *device, unsigned int timestamp);
 
+device_status_t
+uwatec_aladin_device_poll (device_t *device, dc_buffer_t *buffer);
+
 device_status_t
 uwatec_aladin_extract_dives (device_t *device, const unsigned char data[], unsigned int size, dive_callback_t callback, void *userdata);
 
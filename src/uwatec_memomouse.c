@@ -60,6 +60,8 @@ static const device_backend_t uwatec_memomouse_device_backend = {
 	NULL, /* read */
 	NULL, /* write */
 	uwatec_memomouse_device_dump, /* dump */
+	NULL, /* dump_to */
+	NULL, /* dump_delta */
 	uwatec_memomouse_device_foreach, /* foreach */
 	uwatec_memomouse_device_close /* close */
 };
@@ -104,6 +106,9 @@ uwatec_memomouse_device_open (device_t **out, const char* name)
 		return DEVICE_STATUS_IO;
 	}
 
+	// Record the traffic in the trace buffer.
+	serial_set_trace (device->port, device_get_trace ((device_t *) device));
+
 	// Set the serial communication protocol (9600 8N1).
 	rc = serial_configure (device->port, 9600, 8, SERIAL_PARITY_NONE, 1, SERIAL_FLOWCONTROL_NONE);
 	if (rc == -1) {
@@ -223,14 +228,15 @@ uwatec_memomouse_read_packet (uwatec_memomouse_device_t *device, unsigned char d
 		return EXITCODE (rc);
 	}
 
-	// Reverse the bits.
-	array_reverse_bits (data + 1, len + 1);
+	// Reverse the bits and calculate the checksum in a single pass.
+	unsigned char ccrc = array_reverse_bits_xor_uint8 (data + 1, len, data[0]);
+	array_reverse_bits (data + len + 1, 1);
 
 	// Verify the checksum of the package.
 	unsigned char crc = data[len + 1];
-	unsigned char ccrc = checksum_xor_uint8 (data, len + 1, 0x00);
 	if (crc != ccrc) {
 		WARNING ("Unexpected answer CRC.");
+		device_stats_crc ((device_t *) device);
 		return DEVICE_STATUS_PROTOCOL;
 	}
 
@@ -243,13 +249,20 @@ uwatec_memomouse_read_packet (uwatec_memomouse_device_t *device, unsigned char d
 static device_status_t
 uwatec_memomouse_read_packet_outer (uwatec_memomouse_device_t *device, unsigned char data[], unsigned int size, unsigned int *result)
 {
+	device_t *abstract = (device_t *) device;
+
+	unsigned int timestamp = device_stats_begin (abstract);
 	device_status_t rc = DEVICE_STATUS_SUCCESS;
 	while ((rc = uwatec_memomouse_read_packet (device, data, size, result)) != DEVICE_STATUS_SUCCESS) {
+		device_stats_error (abstract, rc);
+
 		// Automatically discard a corrupted packet, 
 		// and request a new one.
 		if (rc != DEVICE_STATUS_PROTOCOL)
 			return rc;	
 
+		timestamp = device_stats_retry (abstract);
+
 		// Flush the input buffer.
 		serial_flush (device->port, SERIAL_QUEUE_INPUT);
 
@@ -262,6 +275,8 @@ uwatec_memomouse_read_packet_outer (uwatec_memomouse_device_t *device, unsigned
 		}
 	}
 
+	device_stats_end (abstract, timestamp);
+
 	return DEVICE_STATUS_SUCCESS;
 }
 
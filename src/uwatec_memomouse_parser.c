@@ -175,6 +175,8 @@ uwatec_memomouse_parser_samples_foreach (parser_t *abstract, sample_callback_t c
 		if (callback) callback (SAMPLE_TYPE_DEPTH, sample, userdata);
 
 		// Warnings
+		if (!SAMPLE_ENABLED (abstract, SAMPLE_TYPE_EVENT))
+			warnings = 0;
 		for (unsigned int i = 0; i < 6; ++i) {
 			if (warnings & (1 << i)) {
 				sample.event.time = 0;
@@ -221,7 +223,8 @@ uwatec_memomouse_parser_samples_foreach (parser_t *abstract, sample_callback_t c
 				offset++;
 			}
 
-			if (callback) callback (SAMPLE_TYPE_VENDOR, sample, userdata);
+			if (callback && SAMPLE_ENABLED (abstract, SAMPLE_TYPE_VENDOR))
+				callback (SAMPLE_TYPE_VENDOR, sample, userdata);
 		}
 
 		time += 20;
@@ -55,6 +55,8 @@ static const device_backend_t uwatec_smart_device_backend = {
 	NULL, /* read */
 	NULL, /* write */
 	uwatec_smart_device_dump, /* dump */
+	NULL, /* dump_to */
+	NULL, /* dump_delta */
 	uwatec_smart_device_foreach, /* foreach */
 	uwatec_smart_device_close /* close */
 };
@@ -180,6 +182,9 @@ uwatec_smart_device_open (device_t **out)
 		return DEVICE_STATUS_IO;
 	}
 
+	// Record the traffic in the trace buffer.
+	irda_socket_set_trace (device->socket, device_get_trace ((device_t *) device));
+
 	// Discover the device.
 	rc = irda_socket_discover (device->socket, uwatec_smart_discovery, device);
 	if (rc == -1) {
@@ -334,6 +334,36 @@ uwatec_smart_sample_info_t uwatec_galileo_sol_table [] = {
 	{ALARMS,					8, 0, 1}, // 1111 1001 dddddddd
 };
 
+static int
+uwatec_smart_is_requested (parser_t *abstract, uwatec_smart_sample_t type)
+{
+	switch (type) {
+	case DELTA_RBT:
+	case ABSOLUTE_RBT:
+		return SAMPLE_ENABLED (abstract, SAMPLE_TYPE_RBT);
+	case DELTA_TEMPERATURE:
+	case ABSOLUTE_TEMPERATURE:
+		return SAMPLE_ENABLED (abstract, SAMPLE_TYPE_TEMPERATURE);
+	case DELTA_TANK_PRESSURE:
+	case ABSOLUTE_TANK_1_PRESSURE:
+	case ABSOLUTE_TANK_2_PRESSURE:
+	case ABSOLUTE_TANK_D_PRESSURE:
+		return SAMPLE_ENABLED (abstract, SAMPLE_TYPE_PRESSURE);
+	case DELTA_HEARTRATE:
+	case ABSOLUTE_HEARTRATE:
+		return SAMPLE_ENABLED (abstract, SAMPLE_TYPE_HEARTBEAT);
+	case BEARING:
+		return SAMPLE_ENABLED (abstract, SAMPLE_TYPE_BEARING);
+	case ALARMS:
+		return SAMPLE_ENABLED (abstract, SAMPLE_TYPE_VENDOR);
+	default:
+		// The time and depth samples are always processed,
+		// because they maintain the time of all samples.
+		return 1;
+	}
+}
+
+
 static parser_status_t
 uwatec_smart_parser_samples_foreach (parser_t *abstract, sample_callback_t callback, void *userdata)
 {
@@ -411,6 +441,9 @@ uwatec_smart_parser_samples_foreach (parser_t *abstract, sample_callback_t callb
 		// Skip the processed type bytes.
 		offset += table[id].ntypebits / NBITS;
 
+		// Check whether the sample is requested.
+		int requested = uwatec_smart_is_requested (abstract, table[id].type);
+
 		// Process the remaining data bits.
 		unsigned int nbits = 0;
 		unsigned int value = 0;
@@ -427,24 +460,32 @@ uwatec_smart_parser_samples_foreach (parser_t *abstract, sample_callback_t callb
 			offset++;
 		}
 
-		// Process the extra data bytes.
+		// Process the extra data bytes. The data bytes of samples
+		// that are not requested are skipped without decoding.
 		assert (offset + table[id].extrabytes <= size);
-		for (unsigned int i = 0; i < table[id].extrabytes; ++i) {
-			nbits += NBITS;
-			value <<= NBITS;
-			value += data[offset];
-			offset++;
+		if (!requested) {
+			offset += table[id].extrabytes;
+		} else {
+			for (unsigned int i = 0; i < table[id].extrabytes; ++i) {
+				nbits += NBITS;
+				value <<= NBITS;
+				value += data[offset];
+				offset++;
+			}
 		}
 
-		// Fix the sign bit.
-		signed int svalue = uwatec_smart_fixsignbit (value, nbits);
-
 		if (complete && table[id].type != TIME) {
 			complete = 0;
 			sample.time = time;
 			if (callback) callback (SAMPLE_TYPE_TIME, sample, userdata);
 		}
 
+		if (!requested)
+			continue;
+
+		// Fix the sign bit.
+		signed int svalue = uwatec_smart_fixsignbit (value, nbits);
+
 		// Parse the value.
 		switch (table[id].type) {
 		case DELTA_TANK_PRESSURE_DEPTH: